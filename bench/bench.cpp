@@ -0,0 +1,239 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks for the solver kernels. Each line of output is a JSON
+ * object with the kernel, instance size, operations timed, nanoseconds per
+ * operation, operations per second and heap allocations per operation.
+ */
+
+#include "chain.h"
+#include "config.h"
+#include "context.h"
+#include "evaluator.h"
+#include "heuristic.h"
+#include "loader.h"
+#include "node.h"
+#include "pool.h"
+#include "prng.h"
+#include "solution.h"
+#include "solver.h"
+#include "temperature.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+using hrc = std::chrono::high_resolution_clock;
+using std::atomic;
+using std::function;
+using std::fprintf;
+using std::printf;
+using std::string;
+using std::uint64_t;
+using std::vector;
+
+/* Minimum time spent on each kernel, in seconds */
+static double const MIN_TIME = 0.25;
+
+/* Heap allocations made by the whole program */
+static atomic<unsigned long> allocations(0);
+
+void *operator new(std::size_t size)
+{
+	allocations++;
+	void *p = std::malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+/* Random instance made just like generator.py does */
+static Instance generate(unsigned int n, uint64_t seed)
+{
+	Prng rng(seed);
+	Instance inst{(double)n * (n - 1) / 2, 0, vector<unsigned int>{},
+		vector<Node>{}};
+	unsigned int half = n / 2 > 1 ? n / 2 : 2;
+	for (unsigned int i = 1; i < n; i++)
+		inst.demand.push_back(1 + rng.below(half - 1));
+	for (unsigned int i = 1; i < n; i++) {
+		double x = (1 + rng.below(half - 1)) * rng.real();
+		double y = (1 + rng.below(half - 1)) * rng.real();
+		inst.coords.push_back(Node{x, y});
+	}
+	return inst;
+}
+
+/* Steps taken before the annealing loop is checked not to allocate */
+static unsigned int const WARMUP = 1 << 14;
+
+/*
+ * Time a kernel, running batches of ops operations until enough time is
+ * spent, and report it. Return its allocations per operation.
+ */
+static double measure(char const *kernel, unsigned int n, unsigned long ops,
+	function<void(void)> const &run)
+{
+	unsigned long total = 0;
+	unsigned long allocs = 0;
+	double secs = 0.0;
+	do {
+		unsigned long a = allocations;
+		hrc::time_point st = hrc::now();
+		run();
+		secs += std::chrono::duration<double>(hrc::now() - st).count();
+		allocs += allocations - a;
+		total += ops;
+	} while (secs < MIN_TIME);
+
+	printf("{\"kernel\": \"%s\", \"n\": %u, \"ops\": %lu, "
+		"\"ns_per_op\": %.3f, \"ops_per_sec\": %.1f, "
+		"\"allocs_per_op\": %.3f}\n",
+		kernel, n, total, secs * 1e9 / (double)total,
+		(double)total / secs, (double)allocs / (double)total);
+	fflush(stdout);
+	return (double)allocs / (double)total;
+}
+
+/*
+ * Benchmark every kernel on an instance of n nodes. Fail if the annealing
+ * loop allocates once its buffers have grown.
+ */
+static bool bench(struct rcvrp_cfg const &cfg, unsigned int n, uint64_t seed)
+{
+	Context ctx(cfg);
+	Pool pool(cfg.threads);
+	Instance inst = generate(n, seed);
+	double threshold = inst.threshold;
+	Solution sol = Solver::prepare(ctx, inst, cfg.v_cap, pool);
+	unsigned int k = sol.size();
+
+	/* Preprocessing */
+	measure("distance_build", n, 1, [&]() {
+		ctx.distance.build(ctx.coords, (std::size_t)cfg.dist_mem << 20);
+	});
+	if (k <= cfg.avg_exact)
+		measure("avg_dist", n, 1, [&]() {
+			Heuristic::avg_dist(ctx.distance, pool);
+		});
+	measure("avg_dist_sampled", n, 1, [&]() {
+		Heuristic::avg_dist_sampled(ctx.distance, 0.001);
+	});
+	measure("prim", n, 1, [&]() {
+		vector<unsigned int> perm(sol.perm);
+		Heuristic::prim(ctx.coords, perm);
+	});
+
+	/* Full evaluation, with every kernel this CPU runs */
+	measure("eval", n, 16, [&]() {
+		for (unsigned int i = 0; i < 16; i++)
+			sol.eval(threshold);
+	});
+	for (int isa = Evaluator::SCALAR; isa <= Evaluator::best(); isa++) {
+		string kernel = string("eval_") +
+			Evaluator::name((Evaluator::Isa)isa);
+		measure(kernel.c_str(), n, 16, [&]() {
+			for (unsigned int i = 0; i < 16; i++)
+				Evaluator::eval(ctx.distance, ctx.demand,
+					sol.perm, sol.orig, threshold,
+					ctx.avg_dist, ctx.cfg.v_cap,
+					(Evaluator::Isa)isa);
+		});
+	}
+
+	/* Movements, evaluated incrementally */
+	sol.track(threshold);
+	Prng rng(seed);
+	measure("any_neighbor", n, 1 << 16, [&]() {
+		for (unsigned int i = 0; i < 1 << 16; i++)
+			sol.any_neighbor(rng);
+	});
+	measure("delta", n, 1 << 12, [&]() {
+		for (unsigned int i = 0; i < 1 << 12; i++)
+			sol.delta(sol.any_neighbor(rng));
+	});
+	measure("apply_undo", n, 1 << 12, [&]() {
+		for (unsigned int i = 0; i < 1 << 12; i++) {
+			Move mv = sol.any_neighbor(rng);
+			sol.apply(mv);
+			sol.undo(mv);
+		}
+	});
+
+	/* The annealing loop itself, without the clock, once warmed up */
+	Chain chain(sol, seed);
+	Temperature t(cfg.temperature, cfg);
+	for (unsigned int i = 0; i < WARMUP; i++)
+		chain.step(t);
+	bool steady = !(measure("sa_step", n, 1 << 12, [&]() {
+		for (unsigned int i = 0; i < 1 << 12; i++)
+			chain.step(t);
+	}) > 0.0);
+	if (!steady)
+		fprintf(stderr, "rcvrp-bench: sa_step allocates at n = %u\n",
+			n);
+
+	/* Proposals scored in batches, about as many of them */
+	for (unsigned int m = 4; m <= 16; m *= 2) {
+		string kernel = "sa_steps_" + std::to_string(m);
+		measure(kernel.c_str(), n, 1 << 12, [&]() {
+			for (unsigned int i = 0; i < 1 << 12; )
+				i += chain.steps(t, m);
+		});
+	}
+	return steady;
+}
+
+int main(int argc, char const **argv)
+{
+	/* Defaults and environment variables, sizes are given as arguments */
+	struct rcvrp_cfg cfg;
+	char const *none[] = {argv[0]};
+	parse_cfg(cfg, 1, none);
+	if (!getenv("THREADS"))
+		cfg.threads = 1;
+
+	vector<unsigned int> sizes;
+	for (int i = 1; i < argc; i++)
+		sizes.push_back((unsigned int)std::strtoul(argv[i], nullptr, 10));
+	if (sizes.empty())
+		sizes = vector<unsigned int>{100, 1000, 10000, 100000};
+
+	uint64_t seed = cfg.seed ? cfg.seed : 1;
+	int status = 0;
+	for (unsigned int i = 0; i < sizes.size(); i++)
+		if (sizes[i] > 1 && !bench(cfg, sizes[i], seed))
+			status = 1;
+	return status;
+}
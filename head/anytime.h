@@ -0,0 +1,50 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __anytime_h__
+#define __anytime_h__
+
+#include "timer.h"
+#include <atomic>
+#include <fstream>
+#include <mutex>
+
+/*
+ * Stream of every new global best found by workers, as one JSON object per
+ * line with its cost, vehicles and when it was found
+ */
+class Anytime {
+private:
+	std::ofstream file;
+	std::ostream *out;
+	std::mutex lock;
+	std::atomic<double> hint;
+	Timer timer;
+public:
+	Anytime(char const *path);
+	Anytime(Anytime const &) = delete;
+	Anytime &operator=(Anytime const &) = delete;
+
+	/* Cost of the best solution reported, infinity if there is none */
+	double cost(void) const;
+
+	/* Report a solution, unless an equal or better one was already */
+	void offer(double cost, unsigned int vehicles);
+};
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __batch_h__
+#define __batch_h__
+
+#include "context.h"
+#include "pool.h"
+
+/*
+ * Solve many instances on a single pool, a few at once, each in a context of
+ * its own whose worker records are handed over to ctx. The source is a
+ * directory, a manifest file listing one instance path per line, or "-" for
+ * instances concatenated on stdin. Results go to <output>/<name>.sol, or to
+ * stdout after a "# <name>" line if output is null, as instances finish.
+ * Returns an exit status.
+ */
+int batch(Context &ctx, char const *source, char const *output, Pool &pool);
+
+#endif
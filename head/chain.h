@@ -0,0 +1,141 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __chain_h__
+#define __chain_h__
+
+#include "prng.h"
+#include "solution.h"
+#include "telemetry.h"
+#include <cstdint>
+#include <vector>
+
+/* Proposal scored along others, see Chain::steps */
+struct Candidate {
+	Move mv;
+	unsigned int anchor;
+	double diff;
+	bool feasible;
+};
+
+/*
+ * Markov chain of solutions, remembering the best one it visited. The best
+ * solution is only copied when the chain is about to leave it.
+ */
+class Chain {
+private:
+	Solution best;
+	bool at_best;
+	std::vector<Candidate> batch;
+
+	/* Move to an accepted neighbor, tracking the best solution */
+	void take(Move const &mv, double diff);
+public:
+	Solution curr;
+	double best_cost;
+	Prng rng;
+
+	/* Moves taken so far */
+	unsigned long accepted;
+
+	/* Counters of the worker stepping the chain, if any */
+	Telemetry *tm;
+
+	Chain(Solution const &sol, std::uint64_t seed, Telemetry *_tm = nullptr);
+	Chain(Chain const &other) = default;
+	Chain &operator=(Chain const &other) = default;
+
+	/* Metropolis step, temperature t() is only read on worsening moves */
+	template <typename Thermometer>
+	bool step(Thermometer &t);
+
+	/*
+	 * Up to k Metropolis steps, whose proposals are drawn and scored
+	 * together. Returns how many proposals were used.
+	 */
+	template <typename Thermometer>
+	unsigned int steps(Thermometer &t, unsigned int k);
+
+	/* Best solution so far, and the vehicles it needs */
+	Solution const &snapshot(void);
+	unsigned int best_fleet(void) const;
+
+	/* Continue from another (better) solution */
+	void restart(Solution const &sol, double cost);
+};
+
+template <typename Thermometer>
+bool Chain::step(Thermometer &t)
+{
+	/* Evaluate a neighbor, looking only at what it changes */
+	Move mv = curr.any_neighbor(rng);
+	bool feasible;
+	double diff = -curr.delta(mv, tm ? &feasible : nullptr);
+	if (tm)
+		tm->propose(mv, feasible);
+
+	/* If neighbor is better, keep it. Or maybe just keep it randomly */
+	if (!(diff > 0.0f) && !rng.metropolis(diff, t())) {
+		curr.reject(curr.picked());
+		return false;
+	}
+	take(mv, diff);
+	return true;
+}
+
+/*
+ * Every proposal is drawn from the current solution and scored before any
+ * is decided on, so their loads are independent. Then they are decided in
+ * order and the first accepted one is taken. Rejected proposals leave the
+ * solution untouched, so this is the very same chain k single steps make,
+ * only the proposals after an accepted one are wasted.
+ */
+template <typename Thermometer>
+unsigned int Chain::steps(Thermometer &t, unsigned int k)
+{
+	if (k <= 1) {
+		step(t);
+		return 1;
+	}
+
+	/* Positions of earlier proposals must stay valid for later ones */
+	curr.unwrap();
+	batch.resize(k);
+	for (unsigned int i = 0; i < k; i++) {
+		batch[i].mv = curr.any_neighbor(rng);
+		batch[i].anchor = curr.picked();
+	}
+	for (unsigned int i = 0; i < k; i++)
+		batch[i].diff = -curr.delta(batch[i].mv,
+			tm ? &batch[i].feasible : nullptr);
+
+	for (unsigned int i = 0; i < k; i++) {
+		Candidate const &c = batch[i];
+		if (tm)
+			tm->propose(c.mv, c.feasible);
+		if (!(c.diff > 0.0f) && !rng.metropolis(c.diff, t())) {
+			curr.reject(c.anchor);
+			continue;
+		}
+		take(c.mv, c.diff);
+		return i + 1;
+	}
+	return k;
+}
+
+#endif
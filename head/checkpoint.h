@@ -0,0 +1,53 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __checkpoint_h__
+#define __checkpoint_h__
+
+#include "solution.h"
+#include <mutex>
+#include <string>
+
+/*
+ * Best solution offered by workers, saved to a file along with the schedule
+ * state it was found at, so an interrupted run can be resumed from it. Files
+ * are replaced atomically, a crash leaves the previous one.
+ */
+class Checkpoint {
+private:
+	std::string path;
+	double thr;
+	std::mutex lock;
+	Solution best;
+	double best_cost;
+	double temperature;
+	double progress;
+
+	/* Save the kept solution */
+	void write(void);
+public:
+	Checkpoint(char const *_path, double threshold);
+	Checkpoint(Checkpoint const &) = delete;
+	Checkpoint &operator=(Checkpoint const &) = delete;
+
+	/* Keep a solution if it is the best so far, saving it right away */
+	void offer(Solution const &sol, double cost, double temperature,
+		double progress);
+};
+
+#endif
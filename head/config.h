@@ -19,6 +19,39 @@
 #ifndef __config_h__
 #define __config_h__
 
+#include <string>
+
+/* How threads work together */
+enum rcvrp_mode {
+	MODE_INDEPENDENT,
+	MODE_ISLAND,
+	MODE_TEMPERING,
+	MODE_DECOMPOSE
+};
+
+/* How temperature changes along a run */
+enum rcvrp_schedule {
+	SCHEDULE_AUTO,
+	SCHEDULE_FIXED
+};
+
+/* How customers are split among parts when decomposing */
+enum rcvrp_partition {
+	PARTITION_SWEEP,
+	PARTITION_KMEANS
+};
+
+/* Kinds of neighbors, chosen with user given weights */
+enum rcvrp_move {
+	MOVE_FLIP,
+	MOVE_KOPT,
+	MOVE_RELOCATE,
+	MOVE_OROPT,
+	MOVE_EXCHANGE,
+	MOVE_TWOOPT,
+	MOVES
+};
+
 /* Store configuration in a struct */
 struct rcvrp_cfg {
 	double risk_threshold;
@@ -26,14 +59,49 @@ struct rcvrp_cfg {
 	double temperature;
 	unsigned int max_iter;
 	unsigned int max_ms;
+	unsigned long budget;
 	unsigned int threads;
 	unsigned int v_cap;
+	unsigned int dist_mem;
+	unsigned long seed;
+	enum rcvrp_mode mode;
+	enum rcvrp_schedule schedule;
+	unsigned int migration;
+	unsigned int replicas;
+	unsigned int avg_exact;
+	unsigned int restarts;
+	unsigned int parts;
+	unsigned int rounds;
+	enum rcvrp_partition partition;
+	double mix[MOVES];
+	unsigned int neighbors;
+	unsigned int candidates;
+	unsigned int trace_every;
+	unsigned int checkpoint_ms;
+	double resume_temperature;
+	double resume_progress;
+	char const *telemetry;
+	char const *anytime;
+	char const *input;
+	char const *batch;
+	char const *output;
+	char const *start;
+	char const *checkpoint;
+	char const *delta;
+	char const *serve;
 };
 
-/* A static global struct */
-extern struct rcvrp_cfg ctx;
+/* Default configuration */
+void default_cfg(struct rcvrp_cfg &cfg);
+
+/*
+ * Set a variable, named as its environment variable. Paths are not copied,
+ * the value must outlive the configuration.
+ */
+void set_cfg(struct rcvrp_cfg &cfg, std::string const &name,
+	char const *value);
 
-/* Parse user configuration */
-void parse_cfg(int const argc, char const **argv);
+/* Parse user configuration, from arguments and environment variables */
+void parse_cfg(struct rcvrp_cfg &cfg, int const argc, char const **argv);
 
 #endif
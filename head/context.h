@@ -0,0 +1,81 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __context_h__
+#define __context_h__
+
+#include "config.h"
+#include "distance.h"
+#include "node.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class Telemetry;
+
+/*
+ * Everything a solve depends on: its configuration, the instance being solved
+ * and what is precomputed from it. Solutions point to the context they belong
+ * to, and nothing is shared among contexts, so separate ones may be solved at
+ * once. A context is only written while preparing an instance, workers only
+ * read it.
+ */
+class Context {
+private:
+	/* Whether workers were asked to stop */
+	std::atomic<bool> halt;
+public:
+	struct rcvrp_cfg cfg;
+
+	/* Instance, without the deposit (which sits at the origin) */
+	std::vector<Node> coords;
+	std::vector<unsigned int> demand;
+	Distance distance;
+
+	/* Average distance among nodes, which scales punishments */
+	double avg_dist;
+
+	/* Closest near_k nodes of every node, closest first */
+	std::vector<unsigned int> near;
+	unsigned int near_k;
+
+	/* Context this one solves a part of, which stops it too */
+	Context const *parent;
+
+	/* Flag of whoever holds this context, which stops it too */
+	std::atomic<bool> const *halting;
+
+	/* Records of every worker enrolled so far, see Telemetry */
+	mutable std::mutex enrolled_lock;
+	mutable std::vector< std::unique_ptr<Telemetry> > enrolled;
+
+	explicit Context(struct rcvrp_cfg const &_cfg);
+	Context(Context const &) = delete;
+	Context &operator=(Context const &) = delete;
+	~Context();
+
+	/* Ask every worker to stop, safe from signal handlers */
+	void stop(void);
+	bool stopped(void) const;
+
+	/* Let workers of a later solve run again */
+	void resume(void);
+};
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __decompose_h__
+#define __decompose_h__
+
+#include "pool.h"
+#include "solution.h"
+#include <cstdint>
+
+class Anytime;
+class Checkpoint;
+class Context;
+
+/*
+ * Decomposition solution finder for big instances. Routes are split into
+ * parts by where they are, each part is solved as an instance of its own on
+ * a worker, and solved parts are put together again. Later rounds split
+ * routes anew, so routes on borders meet others. The whole solution is
+ * offered to a checkpoint and a stream after every round, unless they are
+ * null.
+ */
+Solution decompose(Context const &ctx, Solution sol, double risk,
+	std::uint64_t seed, Pool &pool, Checkpoint *saving, Anytime *stream);
+
+#endif
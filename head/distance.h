@@ -0,0 +1,83 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __distance_h__
+#define __distance_h__
+
+#include "node.h"
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/* Precomputed distances among nodes and to the deposit */
+class Distance {
+public:
+	/* How distances among nodes are stored */
+	enum Tier { FULL, TRIANGULAR, COMPUTED };
+private:
+	Tier tier;
+	std::size_t n;
+	std::vector<double> depot_dist;
+	std::vector<double> matrix;
+	std::vector<double> x;
+	std::vector<double> y;
+public:
+	Distance();
+
+	/* Build for some nodes, choosing a tier fitting in budget bytes */
+	void build(std::vector<Node> const &coords, std::size_t budget);
+
+	/* Queries */
+	Tier kind(void) const;
+	std::size_t size(void) const;
+	double depot(unsigned int i) const;
+	double operator() (unsigned int i, unsigned int j) const;
+
+	/* Coordinates of every node, one array per axis */
+	double const *xs(void) const;
+	double const *ys(void) const;
+};
+
+/* Distance from node i to the deposit */
+inline double Distance::depot(unsigned int i) const
+{
+	return depot_dist[i];
+}
+
+/* Distance between nodes i and j */
+inline double Distance::operator() (unsigned int i, unsigned int j) const
+{
+	switch (tier) {
+	case FULL:
+		return matrix[i * n + j];
+	case TRIANGULAR:
+		/* Row i holds distances to nodes 0 to i - 1 */
+		if (i < j)
+			return matrix[(std::size_t)j * (j - 1) / 2 + i];
+		if (j < i)
+			return matrix[(std::size_t)i * (i - 1) / 2 + j];
+		return 0.0;
+	case COMPUTED:
+	default:
+		double dx = x[i] - x[j];
+		double dy = y[i] - y[j];
+		return std::sqrt(dx * dx + dy * dy);
+	}
+}
+
+#endif
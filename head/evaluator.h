@@ -0,0 +1,50 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __evaluator_h__
+#define __evaluator_h__
+
+#include "distance.h"
+#include <vector>
+
+/*
+ * Full evaluation of a solution, vectorized. Coordinates and money are
+ * gathered in permutation order into contiguous arrays, then every step runs
+ * the same branchless code: leg distances are computed a few lanes at a time,
+ * and money and risk are accumulated by scans restarting at every route
+ * start. The scalar kernel sums in the exact order Solution::eval always
+ * did, vector ones may differ by rounding.
+ */
+namespace Evaluator
+{
+	/* Instruction sets a kernel may use, best last */
+	enum Isa { SCALAR, SSE2, AVX2 };
+
+	/* Best instruction set this CPU supports, detected once */
+	Isa best(void);
+	char const *name(Isa isa);
+
+	/* Cost of a solution, infinite if over capacity (0 means unlimited) */
+	double eval(Distance const &dist,
+		std::vector<unsigned int> const &demand,
+		std::vector<unsigned int> const &perm,
+		std::vector<bool> const &orig, double threshold,
+		double avg_dist, unsigned int v_cap, Isa isa = best());
+}
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __exchange_h__
+#define __exchange_h__
+
+#include "solution.h"
+#include <atomic>
+#include <memory>
+
+/* A published solution along with its cost */
+struct Snapshot {
+	double cost;
+	Solution sol;
+};
+
+/* Slot holding the best solution published by cooperating workers */
+class Exchange {
+private:
+	std::shared_ptr<Snapshot const> slot;
+	std::atomic<double> hint;
+public:
+	Exchange();
+	Exchange(Exchange const &) = delete;
+	Exchange &operator=(Exchange const &) = delete;
+
+	/* Cost of the published solution, infinity if there is none */
+	double cost(void) const;
+
+	/* Publish a solution, unless an equal or better one is already there */
+	bool publish(Solution const &sol, double cost);
+
+	/* Get the published solution, possibly empty */
+	std::shared_ptr<Snapshot const> fetch(void) const;
+};
+
+#endif
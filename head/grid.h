@@ -0,0 +1,60 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __grid_h__
+#define __grid_h__
+
+#include "node.h"
+#include <vector>
+
+/* Uniform grid over nodes, answering nearest neighbor queries */
+class Grid {
+private:
+	std::vector<Node> const &coords;
+	double min_x;
+	double min_y;
+	double side;
+	unsigned int cols;
+	unsigned int rows;
+
+	/* Nodes sorted by cell, alive ones first within each cell */
+	std::vector<unsigned int> start;
+	std::vector<unsigned int> alive;
+	std::vector<unsigned int> nodes;
+	std::vector<unsigned int> slot;
+	unsigned int remaining;
+
+	unsigned int col(double x) const;
+	unsigned int row(double y) const;
+public:
+	Grid(std::vector<Node> const &_coords);
+	Grid(Grid const &) = delete;
+	Grid &operator=(Grid const &) = delete;
+
+	/* Remove a node from further queries */
+	void erase(unsigned int node);
+
+	/* Closest remaining node to a node, or the amount of nodes if none */
+	unsigned int nearest(unsigned int node) const;
+
+	/* Up to k closest remaining nodes to another one, closest first */
+	void nearest(unsigned int node, unsigned int k,
+		std::vector<unsigned int> &out) const;
+};
+
+#endif
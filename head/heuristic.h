@@ -19,14 +19,20 @@
 #ifndef __heuristic_h__
 #define __heuristic_h__
 
+#include "distance.h"
 #include "node.h"
+#include "pool.h"
 #include <vector>
 
 /* Heuristic funcions */
 namespace Heuristic
 {
-	void prim(std::vector<Node> &coords, std::vector<unsigned int> &perm);
-	double avg_dist(std::vector<Node> &coords);
+	void prim(std::vector<Node> const &coords,
+		std::vector<unsigned int> &perm);
+	std::vector<unsigned int> neighbors(std::vector<Node> const &coords,
+		unsigned int k);
+	double avg_dist(Distance const &dist, Pool &pool);
+	double avg_dist_sampled(Distance const &dist, double tolerance);
 }
 
 #endif
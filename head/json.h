@@ -0,0 +1,51 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __json_h__
+#define __json_h__
+
+#include <string>
+#include <vector>
+
+/* Parsed JSON value, as much as requests to the solver need */
+class Json {
+public:
+	enum Kind {NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT};
+
+	Kind kind;
+
+	/* Contents of a string, or a number or literal as written */
+	std::string text;
+
+	/* Values of an array, or of an object along with their keys */
+	std::vector<std::string> keys;
+	std::vector<Json> items;
+
+	Json(void);
+
+	/* Member of an object, null if missing */
+	Json const *get(std::string const &key) const;
+
+	/* Parse a whole value, surrounded by whitespace only */
+	static Json parse(char const *begin, char const *end);
+
+	/* Quoted and escaped string */
+	static std::string quote(std::string const &s);
+};
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __loader_h__
+#define __loader_h__
+
+#include "node.h"
+#include <cstddef>
+#include <vector>
+
+/* Problem instance, without the deposit (which sits at the origin) */
+struct Instance {
+	double threshold;
+	unsigned int capacity;
+	std::vector<unsigned int> demand;
+	std::vector<Node> coords;
+};
+
+/*
+ * Solution to start from, as printed by Solution::print, along with the
+ * schedule state a checkpoint saved it with (zero if unknown)
+ */
+struct Start {
+	std::vector< std::vector<unsigned int> > routes;
+	double temperature;
+	double progress;
+};
+
+/*
+ * Change to an instance: a node inserted with some demand at some
+ * coordinates (relative to the deposit), removed, or given a new demand.
+ * Nodes are numbered from 1, as printed.
+ */
+struct Change {
+	enum Kind { INSERT, REMOVE, UPDATE } kind;
+	unsigned int node;
+	unsigned int demand;
+	Node at;
+};
+
+/* Instance readers */
+namespace Loader
+{
+	/* Read a file (memory mapped), or stdin if path is null or "-" */
+	Instance read(char const *path);
+
+	/*
+	 * Parse an instance from memory. Either the plain format (nodes, risk
+	 * threshold, demands and coordinates, deposit first) or a CVRPLIB-like
+	 * keyword format with NODE_COORD_SECTION, DEMAND_SECTION and
+	 * RISK_THRESHOLD.
+	 */
+	Instance parse(char const *begin, char const *end);
+
+	/*
+	 * Parse the next of many concatenated instances, advancing p past it.
+	 * Keyword instances end at their EOF keyword. False if none is left.
+	 */
+	bool next(char const *&p, char const *end, Instance &inst);
+
+	/*
+	 * Read the routes of a printed solution, nodes numbered from 0 as the
+	 * solver does (the deposit is left out). Cost lines are ignored, and
+	 * "# temperature" and "# progress" lines of checkpoints are kept.
+	 */
+	Start start(char const *path);
+
+	/*
+	 * Read changes, one per line: "insert <demand> <x> <y>",
+	 * "remove <node>" or "update <node> <demand>". Lines starting with #
+	 * are ignored.
+	 */
+	std::vector<Change> delta(char const *path);
+
+	/* Read the whole standard input */
+	std::vector<char> slurp(void);
+}
+
+#endif
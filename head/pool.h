@@ -0,0 +1,110 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __pool_h__
+#define __pool_h__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Work stealing thread pool. Each worker pops tasks from the front of its
+ * own queue and steals from the back of the others when it runs dry.
+ */
+class Pool {
+private:
+	struct Queue {
+		std::mutex m;
+		std::deque< std::function<void(void)> > tasks;
+		Queue()
+			: m()
+			, tasks()
+		{}
+	};
+
+	std::vector< std::unique_ptr<Queue> > queues;
+	std::vector<std::thread> workers;
+	std::mutex idle_m;
+	std::condition_variable idle_cv;
+	std::atomic<unsigned long> pending;
+	std::atomic<unsigned int> next;
+	bool stop;
+
+	void push(std::function<void(void)> task);
+	bool pop(unsigned int id, std::function<void(void)> &task);
+	void work(unsigned int id);
+
+	/* Whether the calling thread is a worker, and run a task if so */
+	bool inside(void) const;
+	bool help(void);
+public:
+	explicit Pool(unsigned int n);
+	Pool(Pool const &) = delete;
+	Pool &operator=(Pool const &) = delete;
+	~Pool();
+
+	/* Amount of workers */
+	unsigned int size(void) const;
+
+	/* Bind each worker to its own processor, taking turns if too few */
+	void pin(void);
+
+	/* Run a callable on some worker, get its result through a future */
+	template <typename F>
+	std::future<typename std::result_of<F()>::type> submit(F f);
+
+	/*
+	 * Wait for a result. Workers run queued tasks meanwhile, so tasks may
+	 * wait for tasks of their own without leaving the pool stuck.
+	 */
+	template <typename R>
+	R get(std::future<R> &result);
+};
+
+template <typename F>
+std::future<typename std::result_of<F()>::type> Pool::submit(F f)
+{
+	typedef typename std::result_of<F()>::type R;
+	std::shared_ptr< std::packaged_task<R(void)> > task =
+		std::make_shared< std::packaged_task<R(void)> >(f);
+	std::future<R> result = task->get_future();
+	push([task]() { (*task)(); });
+	return result;
+}
+
+template <typename R>
+R Pool::get(std::future<R> &result)
+{
+	if (!inside())
+		return result.get();
+	while (result.wait_for(std::chrono::seconds(0)) !=
+			std::future_status::ready)
+		if (!help())
+			result.wait_for(std::chrono::milliseconds(1));
+	return result.get();
+}
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __prng_h__
+#define __prng_h__
+
+#include <cmath>
+#include <cstdint>
+
+/* Fast seeded PRNG (xoshiro256**), one per worker */
+class Prng {
+private:
+	std::uint64_t s[4];
+	static std::uint64_t rotl(std::uint64_t x, int k);
+public:
+	typedef std::uint64_t result_type;
+
+	explicit Prng(std::uint64_t seed);
+
+	static constexpr result_type min(void) { return 0; }
+	static constexpr result_type max(void) { return UINT64_MAX; }
+
+	/* Draws */
+	result_type operator() (void);
+	unsigned int below(unsigned int n);
+	double real(void);
+
+	/* Metropolis acceptance of a worsening of diff (<= 0) at temperature t */
+	bool metropolis(double diff, double t);
+
+	/* Seed of the i-th worker derived from a base seed */
+	static std::uint64_t derive(std::uint64_t seed, std::uint64_t i);
+};
+
+inline std::uint64_t Prng::rotl(std::uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+/* Next 64 random bits */
+inline Prng::result_type Prng::operator() (void)
+{
+	std::uint64_t r = rotl(s[1] * 5, 7) * 9;
+	std::uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+	return r;
+}
+
+/* Integer in [0, n), by multiply and shift instead of a division */
+inline unsigned int Prng::below(unsigned int n)
+{
+	return (unsigned int)(((*this)() >> 32) * n >> 32);
+}
+
+/* Real number in [0, 1) */
+inline double Prng::real(void)
+{
+	return (double)((*this)() >> 11) * 0x1.0p-53;
+}
+
+/*
+ * Accept with probability exp(diff / t). As 1 + x <= exp(x) <= 1 / (1 - x)
+ * for x <= 0, exp is only computed when u falls between both bounds.
+ */
+inline bool Prng::metropolis(double diff, double t)
+{
+	double x = diff / t;
+	double u = real();
+
+	if (u < 1.0 + x)
+		return true;
+	if (u * (1.0 - x) >= 1.0)
+		return false;
+	return u < std::exp(x);
+}
+
+#endif
@@ -18,4 +18,81 @@
 #ifndef __rcvrp_h__
 #define __rcvrp_h__
 
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * C interface of the solver library. Each handle holds its own configuration,
+ * instance and solution, so different handles may be used on different
+ * threads at once. A single handle must not be used by two threads at once,
+ * except for rcvrp_stop. Functions returning int give 0 on success and -1 on
+ * failure, which rcvrp_error describes.
+ */
+typedef struct rcvrp rcvrp;
+
+/* New handle with the default configuration, or null if out of memory */
+rcvrp *rcvrp_new(void);
+void rcvrp_free(rcvrp *r);
+
+/*
+ * Set a variable, named and valued as its environment variable (LOOPTIME,
+ * MODE, ...). Variables used while loading (CAPACITY, DISTMEM, AVGEXACT and
+ * NEIGHBORS) take effect on the next load, the rest on the next solve.
+ */
+int rcvrp_set(rcvrp *r, char const *name, char const *value);
+
+/* Load an instance from a file, or from memory, in any accepted format */
+int rcvrp_load(rcvrp *r, char const *path);
+int rcvrp_parse(rcvrp *r, char const *text, size_t length);
+
+/*
+ * Solve the loaded instance for some milliseconds, 0 meaning the configured
+ * LOOPTIME or BUDGET, starting from the best solution so far
+ */
+int rcvrp_solve(rcvrp *r, unsigned int ms);
+
+/*
+ * Queue changes to the loaded instance: a node inserted with some demand at
+ * some coordinates (relative to the deposit), removed, or given a new
+ * demand. Nodes are numbered as printed.
+ */
+int rcvrp_insert(rcvrp *r, unsigned int demand, double x, double y);
+int rcvrp_remove(rcvrp *r, unsigned int node);
+int rcvrp_update(rcvrp *r, unsigned int node, unsigned int demand);
+
+/*
+ * Make the queued changes and solve again only the routes around them, for
+ * a share of the milliseconds given (0 meaning the configured LOOPTIME or
+ * BUDGET) as big as their share of the nodes. Kept nodes are numbered again
+ * in the same order, and inserted ones follow them. Invalid changes are
+ * dropped along with the rest.
+ */
+int rcvrp_replan(rcvrp *r, unsigned int ms);
+
+/*
+ * Stop the running solve early. Safe from any thread or signal handler. A stop
+ * made while no solve is running ends the next one right away.
+ */
+void rcvrp_stop(rcvrp *r);
+
+/*
+ * Best solution so far: its cost, its amount of routes and the nodes of
+ * route i, numbered as printed. Up to size nodes are copied, the length of
+ * the route is returned.
+ */
+double rcvrp_cost(rcvrp const *r);
+unsigned int rcvrp_routes(rcvrp const *r);
+unsigned int rcvrp_route(rcvrp const *r, unsigned int i, unsigned int *nodes,
+	unsigned int size);
+
+/* Description of the last failure */
+char const *rcvrp_error(rcvrp const *r);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
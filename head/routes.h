@@ -0,0 +1,146 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __routes_h__
+#define __routes_h__
+
+#include <vector>
+
+class Context;
+class Solution;
+
+/*
+ * State of a vehicle right after arriving at a node of its route, accumulated
+ * from the deposit. Money is picked up when leaving a node, and the first node
+ * of a route is counted twice, just like a full evaluation does.
+ */
+struct Stop {
+	unsigned int node;
+	double carry;
+	double length;
+	double risk;
+
+	/* Sum of the money carried after each previous step */
+	double carried;
+};
+
+/* Stops of a route within the arena of every route, and room to grow */
+struct Slot {
+	unsigned int first;
+	unsigned int size;
+	unsigned int room;
+};
+
+/* Route being built from pieces of other routes, see Routes::append */
+struct Label {
+	unsigned int last;
+	double carry;
+	double length;
+	double risk;
+
+	/* Money carried on steps over the risk threshold, punished later */
+	double paid;
+	bool empty;
+};
+
+/*
+ * Explicit routes with prefix sums of every stop. The risk and load of any
+ * piece of a route, as if it was carrying a different amount of money, are
+ * known in constant time, so routes made of pieces of others are checked
+ * for feasibility in O(1) per piece, and their punishment is found by a
+ * binary search only when they are over the risk threshold.
+ *
+ * Stops of every route live in a single arena, sized once for the instance,
+ * so routes growing and shrinking while solving never allocate. A route
+ * outgrowing its room moves to the end of the arena with room to double,
+ * and once the end is reached routes are packed again.
+ */
+class Routes {
+private:
+	std::vector<Stop> stops;
+	std::vector<Slot> slots;
+	std::vector<unsigned int> spare;
+	std::vector<unsigned int> of;
+	std::vector<unsigned int> at;
+	std::vector<unsigned int> order;
+	unsigned int end;
+	double thr;
+	Context const *ctx;
+
+	/* Recompute prefix sums of route r from its nodes */
+	void fill(unsigned int r);
+
+	/* Release or take again route r, about to hold n nodes */
+	void mark(unsigned int r, unsigned int n);
+
+	/* Room for n stops of route r, and its nodes written there */
+	void fit(unsigned int r, unsigned int n);
+	void pack(void);
+	void place(unsigned int r, unsigned int const *nodes, unsigned int n);
+public:
+	Routes(void);
+	Routes(Solution const &sol, double threshold);
+	Routes(Routes const &other);
+	Routes &operator=(Routes const &other) = default;
+
+	/* Convert from and to the permutation and route end flags */
+	void read(Solution const &sol, double threshold);
+	void write(Solution &sol) const;
+
+	/* Routes ids are dense, but some of them may be unused */
+	unsigned int count(void) const;
+	unsigned int ids(void) const;
+	bool used(unsigned int r) const;
+
+	/* Where each node is */
+	unsigned int route_of(unsigned int node) const;
+	unsigned int position(unsigned int node) const;
+
+	/* Stops of a route */
+	unsigned int length(unsigned int r) const;
+	Stop const &stop(unsigned int r, unsigned int i) const;
+
+	/* Whole route facts, in constant time */
+	double risk(unsigned int r) const;
+	double load(unsigned int r) const;
+	double distance(unsigned int r) const;
+	bool feasible(unsigned int r) const;
+	double cost(unsigned int r) const;
+
+	/* Build a route by appending stops [i, j) of route r, or a single node */
+	Label open(void) const;
+	void append(Label &l, unsigned int r, unsigned int i, unsigned int j) const;
+	void append(Label &l, unsigned int node) const;
+
+	/*
+	 * Go back to the deposit and return the route cost, infinite if over
+	 * capacity. Maybe tell whether it ends over the risk threshold too.
+	 */
+	double close(Label l, bool *risky = nullptr) const;
+
+	/*
+	 * Replace the n nodes of a route, an empty one is released, or of two
+	 * routes at once, the longer one taking the bigger room
+	 */
+	void assign(unsigned int r, unsigned int const *nodes, unsigned int n);
+	void assign(unsigned int r, unsigned int const *nodes, unsigned int n,
+		unsigned int s, unsigned int const *others, unsigned int m);
+	unsigned int add(unsigned int const *nodes, unsigned int n);
+};
+
+#endif
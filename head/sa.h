@@ -20,8 +20,20 @@
 #define __sa_h__
 
 #include "solution.h"
+#include <cstdint>
 
-/* Simulated Annealing (sa) solution finder */
-Solution sa(Solution sol, double risk);
+class Anytime;
+class Checkpoint;
+class Context;
+class Exchange;
+
+/*
+ * Simulated Annealing (sa) solution finder. Workers sharing an exchange
+ * cooperate as islands, a checkpoint is offered their best solution every
+ * now and then, and new bests are reported to a stream. Any of them may be
+ * null.
+ */
+Solution sa(Context const &ctx, Solution sol, double risk, std::uint64_t seed,
+	Exchange *shared, Checkpoint *saving, Anytime *stream);
 
 #endif
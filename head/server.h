@@ -0,0 +1,34 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __server_h__
+#define __server_h__
+
+#include "config.h"
+#include "pool.h"
+
+/*
+ * Serve solve requests until stdin ends, if path is "-", or forever on a Unix
+ * socket at path, each connection being a stream of its own. Requests and
+ * answers are JSON objects, one per line, and requests are solved at once as
+ * they come, their restarts sharing the workers of a single pool. Returns an
+ * exit status.
+ */
+int serve(struct rcvrp_cfg const &cfg, char const *path, Pool &pool);
+
+#endif
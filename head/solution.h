@@ -19,40 +19,156 @@
 #ifndef __solution_h__
 #define __solution_h__
 
-#include "node.h"
+#include "prng.h"
+#include "routes.h"
+#include <iostream>
+#include <utility>
 #include <vector>
-#include <random>
+
+class Context;
+
+/* Description of a solution movement, applied or evaluated later */
+struct Move {
+	/*
+	 * FLIP:     toggle the route-end flag of node a
+	 * ROTATE:   move the only route end from node a to node b
+	 * KOPT:     reverse positions [a, b) of the permutation
+	 * RELOCATE: move c nodes of a route, from node a on, right after node b
+	 * EXCHANGE: swap nodes a and b
+	 * TWOOPT:   swap what comes after node a and after node b in their
+	 *           routes (2-opt*)
+	 */
+	enum Kind { FLIP, ROTATE, KOPT, RELOCATE, EXCHANGE, TWOOPT } kind;
+	unsigned int a;
+	unsigned int b;
+	unsigned int c;
+
+	/* Amount of kinds */
+	static unsigned int const KINDS = 6;
+};
+
+/* Stops [i, j) of route r, to build a route out of pieces of others */
+struct Piece {
+	unsigned int r;
+	unsigned int i;
+	unsigned int j;
+};
+
+/* Cached state of a single route, stored at its ending node */
+struct Route {
+	double cost;
+	double risk;
+	unsigned int money;
+	bool over;
+};
 
 /* Solution class */
 class Solution {
 private:
-	/* PRNGs */
-	std::uniform_int_distribution<unsigned> r_int;
-	std::uniform_real_distribution<float> r_double;
+	/* Incremental evaluation state */
+	std::vector<unsigned int> pos;
+	std::vector<Route> route;
+	double total;
+	double thr;
+	unsigned int overcap;
+	unsigned int risky;
+	unsigned int vehicles;
+
+	/* State overwritten by the last applied movement, for undoing it */
+	std::vector< std::pair<unsigned int, Route> > journal;
+	double saved_total;
+	unsigned int saved_overcap;
+	unsigned int saved_risky;
+	bool saved_partial;
+	unsigned int saved_a;
+	unsigned int saved_len;
+
+	/*
+	 * Explicit routes, kept along the permutation, for movements among
+	 * routes. Those are undone from a copy of the permutation range they
+	 * rewrote and the nodes of their routes.
+	 */
+	Routes lanes;
+	std::vector<unsigned int> lane;
+	std::vector<unsigned int> saved_perm;
+	std::vector<unsigned int> saved_first;
+	std::vector<unsigned int> saved_second;
+	unsigned int saved_route[2];
+	unsigned int saved_lo;
+	unsigned int saved_vehicles;
+
+	/*
+	 * Don't-look bits: proposals around each node rejected since its
+	 * surroundings last changed. Nodes rejected too often are mostly skipped.
+	 */
+	std::vector<unsigned char> idle;
+	unsigned int anchor;
+
+	/* Nodes movements start from, and their candidate partners */
+	unsigned int pick(Prng &rng);
+	unsigned int candidate(Prng &rng, unsigned int node) const;
+	void wake(Move const &mv);
 
 	/* Solution movements */
-	void flip(void);
-	void kopt(void);
+	Move flip(Prng &rng);
+	Move kopt(Prng &rng);
+	Move relocate(Prng &rng, unsigned int c);
+	Move exchange(Prng &rng);
+	Move twoopt(Prng &rng);
+
+	/* Helpers for incremental evaluation */
+	unsigned int node_at(Move const &mv, unsigned int p) const;
+	bool end_at(Move const &mv, unsigned int node) const;
+	bool span(Move const &mv, unsigned int &a, unsigned int &len) const;
+	void walk(Move const &mv, unsigned int a, unsigned int len,
+		double &cost, unsigned int &over, unsigned int &risk,
+		bool commit);
+	void cached(unsigned int a, unsigned int len,
+		double &cost, unsigned int &over, unsigned int &risk,
+		bool keep);
+	void perform(Move const &mv);
+
+	/* Helpers for movements among routes */
+	void relane(unsigned int a, unsigned int len);
+	void pieces(Move const &mv, Piece *first, unsigned int &n_first,
+		Piece *second, unsigned int &n_second) const;
+	double reroute(Move const &mv, bool *feasible);
+	double shift(Move const &mv);
+	void unshift(void);
+
+	/* Grow scratch buffers once, so applying movements never allocates */
+	void reserve(void);
 public:
+	/* Instance and configuration the solution belongs to */
+	Context const *ctx;
+
 	/* Required variables */
-	static std::vector<Node> coords;
-	static std::vector<unsigned int> demand;
 	std::vector<unsigned int> perm;
 	std::vector<bool> orig;
-	static double avg_dist;
 
 	/* Constructors */
 	Solution();
-	Solution(unsigned int n);
+	Solution(Context const &_ctx, unsigned int n);
 	Solution(Solution const &other);
+	Solution &operator=(Solution const &other);
 
 	/* Methods */
-	void any_neighbor(void);
+	Move any_neighbor(Prng &rng);
 	double eval(double threshold);
+	void track(double threshold);
+	double delta(Move const &mv, bool *feasible = nullptr);
+	unsigned int picked(void) const;
+	void reject(unsigned int node);
+	void unwrap(void);
+	double apply(Move const &mv);
+	void undo(Move const &mv);
+	double reinsert(unsigned int node);
+	double cost(void) const;
+	bool feasible(void) const;
+	unsigned int fleet(void) const;
 	void greedy_init(void);
 	unsigned int size(void);
-	void push_back(Node n);
-	void print(double threshold);
+	void print(double threshold, std::ostream &out = std::cout);
 };
 
 
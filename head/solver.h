@@ -0,0 +1,89 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __solver_h__
+#define __solver_h__
+
+#include "config.h"
+#include "context.h"
+#include "loader.h"
+#include "pool.h"
+#include "solution.h"
+#include <cstdint>
+#include <vector>
+
+/* Whole solving pipeline, shared by every way of running the solver */
+namespace Solver
+{
+	/*
+	 * Load an instance into a context: distances, average distance and the
+	 * greedy initial solution, which is returned. A zero capacity means
+	 * using the instance's own. The average distance is summed on the pool.
+	 */
+	Solution prepare(Context &ctx, Instance &inst, unsigned int v_cap,
+		Pool &pool);
+
+	/*
+	 * Replace a prepared solution by given routes. Unknown and repeated
+	 * nodes are dropped, and nodes left out are inserted where they cost
+	 * least.
+	 */
+	void warm(Solution &sol, Start const &start, double threshold);
+
+	/* Run every restart of the configured mode on a pool, keep the best */
+	Solution solve(Context const &ctx, Solution const &sol, double threshold,
+		std::uint64_t seed, Pool &pool);
+
+	/* Nodes of every route of a solution, in order */
+	std::vector< std::vector<unsigned int> > routes(Solution const &sol);
+
+	/*
+	 * Load some nodes of a context into another one, along with routes of
+	 * theirs to start from. Punishments are scaled alike, so routes cost
+	 * the same in both. Nodes of the part are numbered by their place in
+	 * nodes.
+	 */
+	Solution extract(Context const &ctx,
+		std::vector<unsigned int> const &nodes,
+		std::vector< std::vector<unsigned int> > const &routes,
+		Context &part);
+
+	/*
+	 * Change the instance of a context and repair its solution: removed
+	 * nodes leave their routes, while inserted ones and those with a new
+	 * demand go wherever they cost least. Distances, the average distance
+	 * and candidates are updated as needed, not recomputed. Returns the
+	 * nodes changed, and those next to removed ones.
+	 */
+	std::vector<unsigned int> change(Context &ctx, Solution &sol,
+		std::vector<Change> const &delta);
+
+	/*
+	 * Solve again only routes of some touched nodes, and those around them,
+	 * for a share of the configured time or budget as big as theirs of the
+	 * nodes
+	 */
+	Solution replan(Context const &ctx, Solution const &sol,
+		std::vector<unsigned int> const &touched, double threshold,
+		std::uint64_t seed, Pool &pool);
+
+	/* The user given seed, or a random one */
+	std::uint64_t seed(struct rcvrp_cfg const &cfg);
+}
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __telemetry_h__
+#define __telemetry_h__
+
+#include "solution.h"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+class Context;
+
+/* Point of the temperature and cost trace of a worker */
+struct Sample {
+	unsigned long it;
+	double temp;
+	double cost;
+};
+
+/*
+ * Counters of a single worker. Every worker owns its record and is the only
+ * one writing it, so counting needs no synchronization. Records are read once
+ * every worker is done, when the summary is reported.
+ */
+class Telemetry {
+private:
+	/* Ring buffer of the latest trace samples, allocated on enrollment */
+	std::vector<Sample> trace;
+	unsigned long samples;
+	std::chrono::high_resolution_clock::time_point start;
+	double ms;
+	double best;
+public:
+	std::string role;
+
+	/* Seed the worker started from, to reproduce its run */
+	std::uint64_t seed;
+	unsigned long iterations;
+	unsigned long accepted;
+	unsigned long improving;
+	unsigned long infeasible;
+	unsigned long tried[Move::KINDS + 1];
+	unsigned long taken[Move::KINDS + 1];
+
+	Telemetry(std::string const &_role, unsigned int capacity);
+
+	/*
+	 * Counter of a movement. Or-opt is a relocation of several nodes, it
+	 * gets its own counter after every kind.
+	 */
+	static unsigned int slot(Move const &mv)
+	{
+		return mv.kind == Move::RELOCATE && mv.c > 1 ?
+			(unsigned int)Move::KINDS : (unsigned int)mv.kind;
+	}
+
+	/* A movement was tried, leading to a maybe infeasible solution */
+	void propose(Move const &mv, bool feasible)
+	{
+		iterations++;
+		tried[slot(mv)]++;
+		infeasible += !feasible;
+	}
+
+	/* A tried movement was kept, maybe improving the solution */
+	void accept(Move const &mv, bool improved)
+	{
+		accepted++;
+		taken[slot(mv)]++;
+		improving += improved;
+	}
+
+	/* Record a trace sample, overwriting the oldest one when full */
+	void sample(unsigned long it, double temp, double cost)
+	{
+		trace[samples++ % trace.size()] = Sample{it, temp, cost};
+	}
+
+	/* The worker is done, with its best cost */
+	void finish(double best_cost);
+
+	/* Summary of this worker as a JSON object */
+	void json(std::ostream &out) const;
+
+	/*
+	 * New record for a worker of a context, or null if telemetry is
+	 * disabled. Records live as long as the context.
+	 */
+	static Telemetry *enroll(Context const &ctx, std::string const &role);
+
+	/* Write the summary of every worker of a context so far, if enabled */
+	static void report(Context const &ctx);
+};
+
+#endif
@@ -19,17 +19,72 @@
 #ifndef __temperature_h__
 #define __temperature_h__
 
-/* Thermometer class */
+#include "config.h"
+#include "prng.h"
+#include "solution.h"
+#include <vector>
+
+/*
+ * Thermometer class. It either cools geometrically every few iterations from
+ * a given temperature, or follows a schedule calibrated for the solution at
+ * hand: it starts where a share of moves of typical size is accepted, then
+ * steers the share of moves accepted down along the run to be cold right at
+ * its end, and reheats when the chain freezes without improving.
+ */
 class Temperature {
 private:
 	double curr;
 	unsigned long it;
+
+	/* Fixed schedule, multiplied every few iterations */
+	unsigned int every;
+	double multiplier;
+
+	/* Calibrated schedule, never hotter than it started */
+	bool calibrated;
+	double top;
+
+	/* Chain state at the last update, to tell how it is doing */
+	unsigned long seen_it;
+	unsigned long seen_accepted;
+	double seen_best;
+	unsigned int frozen;
+public:
+	Temperature(double _curr, struct rcvrp_cfg const &cfg);
+	Temperature(Solution &sol, Prng &rng, struct rcvrp_cfg const &cfg);
+	double operator() (void);
+
+	/* Current temperature, without counting an iteration */
+	double value(void) const { return curr; }
+
+	/*
+	 * Follow the calibrated schedule at some progress of the run, from 0
+	 * to 1, given the iterations, accepted moves and best cost so far
+	 */
+	void adapt(double progress, unsigned long iterations,
+		unsigned long accepted, double best);
+
+	/* Sizes of cost changes of random moves from a solution */
+	static std::vector<double> deltas(Solution &sol, Prng &rng,
+		unsigned int samples);
+
+	/* Median cost increase of worsening random moves from a solution */
+	static double sample(Solution &sol, Prng &rng, unsigned int samples);
+
+	/* Temperature accepting a share of such increases on average */
+	static double calibrate(std::vector<double> const &worse,
+		double acceptance);
+};
+
+/* Thermometer stuck at a fixed temperature */
+class Fixed {
+private:
+	double curr;
 public:
-	Temperature(double _curr)
+	Fixed(double _curr)
 		: curr(_curr)
-		, it(0)
 	{}
-	double operator() (void);
+	double operator() (void) const { return curr; }
 };
 
 #endif
@@ -0,0 +1,40 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __tempering_h__
+#define __tempering_h__
+
+#include "pool.h"
+#include "solution.h"
+#include <cstdint>
+
+class Anytime;
+class Checkpoint;
+class Context;
+
+/*
+ * Parallel tempering (replica exchange) solution finder. Replicas run at a
+ * ladder of fixed temperatures, in groups spread over the workers of a pool,
+ * swapping states between adjacent temperatures. The best one is offered to
+ * a checkpoint every now and then, and new bests are reported to a stream,
+ * unless they are null.
+ */
+Solution tempering(Context const &ctx, Solution sol, double risk,
+	std::uint64_t seed, Pool &pool, Checkpoint *saving, Anytime *stream);
+
+#endif
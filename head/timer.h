@@ -25,9 +25,16 @@
 class Timer {
 private:
 	std::chrono::high_resolution_clock::time_point start;
+
+	/* Calls between clock readings, and left until the next one */
+	std::chrono::high_resolution_clock::time_point last;
+	unsigned long every;
+	unsigned long left;
 public:
 	Timer(void);
 	bool loop_incomplete(unsigned int looptime);
+	bool running(unsigned int looptime);
+	double elapsed(void) const;
 };
 
 #endif
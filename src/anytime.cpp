@@ -0,0 +1,83 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "anytime.h"
+#include "timer.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+
+using dl = std::numeric_limits<double>;
+using std::cerr;
+using std::fixed;
+using std::int64_t;
+using std::lock_guard;
+using std::memory_order_relaxed;
+using std::mutex;
+using std::string;
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::system_clock;
+
+/* Stream to a file, or stderr if path is "-" */
+Anytime::Anytime(char const *path)
+	: file()
+	, out(&cerr)
+	, lock()
+	, hint(dl::infinity())
+	, timer()
+{
+	if (string(path) != "-") {
+		file.open(path);
+		out = &file;
+	}
+}
+
+/* Cost of the best solution reported. Cheap, meant to be polled often. */
+double Anytime::cost(void) const
+{
+	return hint.load(memory_order_relaxed);
+}
+
+/*
+ * Report a solution, unless an equal or better one was already. Lines are
+ * flushed right away, for whoever follows the stream.
+ */
+void Anytime::offer(double cost, unsigned int vehicles)
+{
+	if (!(cost < hint.load(memory_order_relaxed)))
+		return;
+
+	lock_guard<mutex> guard(lock);
+	if (!(cost < hint.load(memory_order_relaxed)))
+		return;
+	hint.store(cost, memory_order_relaxed);
+
+	int64_t now = (int64_t)duration_cast<milliseconds>(
+		system_clock::now().time_since_epoch()).count();
+	out->precision(6);
+	*out << fixed << "{\"ms\":" << timer.elapsed()
+		<< ",\"time\":" << now
+		<< ",\"cost\":" << cost
+		<< ",\"vehicles\":" << vehicles << "}\n";
+	out->flush();
+}
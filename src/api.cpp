@@ -0,0 +1,304 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "rcvrp.h"
+#include "config.h"
+#include "context.h"
+#include "loader.h"
+#include "node.h"
+#include "pool.h"
+#include "routes.h"
+#include "solution.h"
+#include "solver.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using std::atomic;
+using std::exception;
+using std::list;
+using std::memory_order_relaxed;
+using std::runtime_error;
+using std::string;
+using std::uint64_t;
+using std::unique_ptr;
+using std::vector;
+
+/* Variables shaping a loaded instance, which wait for the next load */
+static char const *const LOADING[] = {
+	"CAPACITY", "DISTMEM", "AVGEXACT", "NEIGHBORS"
+};
+
+/*
+ * Handle of the C interface: a configuration, the context of the loaded
+ * instance and the best solution found for it so far
+ */
+struct rcvrp {
+	struct rcvrp_cfg cfg;
+
+	/* Values given to rcvrp_set, which the configuration points to */
+	list<string> values;
+
+	unique_ptr<Context> ctx;
+	Solution best;
+	double cost;
+
+	/* Nodes of each route of the best solution, numbered as printed */
+	vector< vector<unsigned int> > routes;
+
+	/* Changes to the instance, made on the next replan */
+	vector<Change> changes;
+
+	string error;
+
+	/* Whether the current or next solve was asked to stop */
+	atomic<bool> halt;
+
+	rcvrp(void);
+};
+
+rcvrp::rcvrp(void)
+	: cfg()
+	, values()
+	, ctx()
+	, best()
+	, cost(0.0)
+	, routes()
+	, changes()
+	, error()
+	, halt(false)
+{
+	default_cfg(cfg);
+}
+
+/* Keep a solution as the best one, and its routes */
+static void keep(rcvrp *r, Solution const &sol)
+{
+	double threshold = r->ctx->cfg.risk_threshold;
+	r->best = sol;
+	r->cost = r->best.eval(threshold);
+
+	Routes routes(r->best, threshold);
+	r->routes.clear();
+	for (unsigned int i = 0; i < routes.ids(); i++) {
+		if (!routes.used(i))
+			continue;
+		r->routes.push_back(vector<unsigned int>{});
+		for (unsigned int t = 0; t < routes.length(i); t++)
+			r->routes.back().push_back(routes.stop(i, t).node + 1);
+	}
+}
+
+/* Use a loaded instance in a new context, starting from its greedy solution */
+static void prepare(rcvrp *r, Instance &inst)
+{
+	r->ctx.reset(new Context(r->cfg));
+	r->ctx->halting = &r->halt;
+	r->changes.clear();
+	Pool pool(r->cfg.threads);
+	keep(r, Solver::prepare(*r->ctx, inst, r->cfg.v_cap, pool));
+}
+
+/* Keep the reason of a failure */
+static int fail(rcvrp *r, exception const &e)
+{
+	r->error = e.what();
+	return -1;
+}
+
+rcvrp *rcvrp_new(void)
+{
+	try {
+		return new rcvrp();
+	} catch (exception const &) {
+		return nullptr;
+	}
+}
+
+void rcvrp_free(rcvrp *r)
+{
+	delete r;
+}
+
+int rcvrp_set(rcvrp *r, char const *name, char const *value)
+{
+	try {
+		r->values.push_back(value);
+		char const *v = r->values.back().c_str();
+		set_cfg(r->cfg, name, v);
+
+		/* The loaded instance only takes those used while solving */
+		bool loading = false;
+		for (unsigned int i = 0; i < sizeof(LOADING) / sizeof(*LOADING);
+				i++)
+			loading = loading || string(name) == LOADING[i];
+		if (r->ctx && !loading)
+			set_cfg(r->ctx->cfg, name, v);
+	} catch (exception const &e) {
+		return fail(r, e);
+	}
+	return 0;
+}
+
+int rcvrp_load(rcvrp *r, char const *path)
+{
+	try {
+		Instance inst = Loader::read(path);
+		prepare(r, inst);
+	} catch (exception const &e) {
+		return fail(r, e);
+	}
+	return 0;
+}
+
+int rcvrp_parse(rcvrp *r, char const *text, size_t length)
+{
+	try {
+		Instance inst = Loader::parse(text, text + length);
+		prepare(r, inst);
+	} catch (exception const &e) {
+		return fail(r, e);
+	}
+	return 0;
+}
+
+/*
+ * Solve the loaded instance, from the best solution so far or only around
+ * nodes touched by changes. A given time replaces the configured time and
+ * budget once, and workers are started for this solve only.
+ */
+static void solve(rcvrp *r, unsigned int ms, bool changed)
+{
+	if (!r->ctx)
+		throw runtime_error("no instance loaded");
+	Context &ctx = *r->ctx;
+
+	vector<unsigned int> touched;
+	if (changed) {
+		vector<Change> changes;
+		changes.swap(r->changes);
+		touched = Solver::change(ctx, r->best, changes);
+		keep(r, r->best);
+	}
+
+	struct rcvrp_cfg saved = ctx.cfg;
+	if (ms) {
+		ctx.cfg.max_ms = ms;
+		ctx.cfg.budget = 0;
+	}
+	Pool pool(ctx.cfg.threads);
+	double threshold = ctx.cfg.risk_threshold;
+	uint64_t seed = Solver::seed(ctx.cfg);
+	Solution sol = changed ?
+		Solver::replan(ctx, r->best, touched, threshold, seed, pool) :
+		Solver::solve(ctx, r->best, threshold, seed, pool);
+	ctx.cfg = saved;
+
+	/* A stop is kept until the solve it was meant for is over */
+	r->halt.store(false, memory_order_relaxed);
+
+	if (sol.eval(threshold) < r->cost)
+		keep(r, sol);
+}
+
+int rcvrp_solve(rcvrp *r, unsigned int ms)
+{
+	try {
+		solve(r, ms, false);
+	} catch (exception const &e) {
+		return fail(r, e);
+	}
+	return 0;
+}
+
+int rcvrp_insert(rcvrp *r, unsigned int demand, double x, double y)
+{
+	try {
+		r->changes.push_back(Change{Change::INSERT, 0, demand, Node(x, y)});
+	} catch (exception const &e) {
+		return fail(r, e);
+	}
+	return 0;
+}
+
+int rcvrp_remove(rcvrp *r, unsigned int node)
+{
+	try {
+		r->changes.push_back(Change{Change::REMOVE, node, 0, Node()});
+	} catch (exception const &e) {
+		return fail(r, e);
+	}
+	return 0;
+}
+
+int rcvrp_update(rcvrp *r, unsigned int node, unsigned int demand)
+{
+	try {
+		r->changes.push_back(Change{Change::UPDATE, node, demand, Node()});
+	} catch (exception const &e) {
+		return fail(r, e);
+	}
+	return 0;
+}
+
+int rcvrp_replan(rcvrp *r, unsigned int ms)
+{
+	try {
+		solve(r, ms, true);
+	} catch (exception const &e) {
+		return fail(r, e);
+	}
+	return 0;
+}
+
+void rcvrp_stop(rcvrp *r)
+{
+	r->halt.store(true, memory_order_relaxed);
+}
+
+double rcvrp_cost(rcvrp const *r)
+{
+	return r->cost;
+}
+
+unsigned int rcvrp_routes(rcvrp const *r)
+{
+	return (unsigned int)r->routes.size();
+}
+
+unsigned int rcvrp_route(rcvrp const *r, unsigned int i, unsigned int *nodes,
+	unsigned int size)
+{
+	if (i >= r->routes.size())
+		return 0;
+	vector<unsigned int> const &route = r->routes[i];
+	for (unsigned int t = 0; t < size && t < route.size(); t++)
+		nodes[t] = route[t];
+	return (unsigned int)route.size();
+}
+
+char const *rcvrp_error(rcvrp const *r)
+{
+	return r->error.c_str();
+}
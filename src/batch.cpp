@@ -0,0 +1,297 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "batch.h"
+#include "config.h"
+#include "context.h"
+#include "loader.h"
+#include "pool.h"
+#include "prng.h"
+#include "solution.h"
+#include "solver.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::cerr;
+using std::condition_variable;
+using std::cout;
+using std::exception;
+using std::getline;
+using std::ifstream;
+using std::lock_guard;
+using std::make_shared;
+using std::max;
+using std::move;
+using std::mutex;
+using std::ofstream;
+using std::ostringstream;
+using std::runtime_error;
+using std::shared_ptr;
+using std::sort;
+using std::string;
+using std::strcmp;
+using std::strerror;
+using std::to_string;
+using std::unique_lock;
+using std::uint64_t;
+using std::vector;
+
+/* Instances coming from a directory, a manifest or a stream */
+class Source {
+private:
+	vector<string> paths;
+	vector<char> stream;
+	char const *p;
+	unsigned int count;
+public:
+	Source(char const *source)
+		: paths()
+		, stream()
+		, p(nullptr)
+		, count(0)
+	{
+		struct stat st;
+		if (!strcmp(source, "-")) {
+			/* Concatenated instances on stdin */
+			stream = Loader::slurp();
+			p = stream.data();
+		} else if (stat(source, &st) == 0 && S_ISDIR(st.st_mode)) {
+			/* Every regular file in a directory, sorted by name */
+			DIR *dir = opendir(source);
+			if (!dir)
+				throw runtime_error(string("can not open ") + source);
+			struct dirent *e;
+			while ((e = readdir(dir))) {
+				string path = string(source) + "/" + e->d_name;
+				struct stat fst;
+				if (stat(path.c_str(), &fst) == 0 && S_ISREG(fst.st_mode))
+					paths.push_back(path);
+			}
+			closedir(dir);
+			sort(paths.begin(), paths.end());
+		} else {
+			/* Manifest, one path per line, # starts a comment */
+			ifstream in(source);
+			if (!in)
+				throw runtime_error(string("can not open ") + source);
+			string line;
+			while (getline(in, line))
+				if (!line.empty() && line[0] != '#')
+					paths.push_back(line);
+		}
+	}
+
+	Source(Source const &) = delete;
+	Source &operator=(Source const &) = delete;
+
+	/* Read the next instance and name it, false if none is left */
+	bool next(Instance &inst, string &name)
+	{
+		if (p) {
+			char const *end = stream.data() + stream.size();
+			name = "stdin." + to_string(count++);
+			try {
+				return Loader::next(p, end, inst);
+			} catch (...) {
+				/* No way to find where the next one starts */
+				p = end;
+				throw;
+			}
+		}
+		if (count >= paths.size())
+			return false;
+		string const &path = paths[count++];
+		size_t slash = path.find_last_of('/');
+		name = slash == string::npos ? path : path.substr(slash + 1);
+		inst = Loader::read(path.c_str());
+		return true;
+	}
+};
+
+/* Instances being solved at once, and whether any of them failed */
+class Flight {
+private:
+	mutex m;
+	condition_variable cv;
+	unsigned int flying;
+	bool failed;
+public:
+	Flight(void)
+		: m()
+		, cv()
+		, flying(0)
+		, failed(false)
+	{}
+	Flight(Flight const &) = delete;
+	Flight &operator=(Flight const &) = delete;
+
+	/* Wait until less than limit instances are flying, take off */
+	void board(unsigned int limit)
+	{
+		unique_lock<mutex> lock(m);
+		while (flying >= limit)
+			cv.wait(lock);
+		flying++;
+	}
+
+	/* An instance failed before taking off */
+	void fail(void)
+	{
+		lock_guard<mutex> lock(m);
+		failed = true;
+	}
+
+	/* An instance finished, maybe failing */
+	void land(bool failure)
+	{
+		lock_guard<mutex> lock(m);
+		failed = failed || failure;
+		flying--;
+		cv.notify_all();
+	}
+
+	/* Wait for every instance */
+	bool wait(void)
+	{
+		unique_lock<mutex> lock(m);
+		while (flying)
+			cv.wait(lock);
+		return failed;
+	}
+};
+
+/*
+ * Solve an instance in a context of its own, write its results, and hand the
+ * records of its workers over to the batch context
+ */
+static bool solve(Context &ctx, Instance &inst, string const &name,
+	uint64_t seed, char const *output, Pool &pool, mutex &writing)
+{
+	Context own(ctx.cfg);
+	own.parent = &ctx;
+	Solution sol = Solver::prepare(own, inst, ctx.cfg.v_cap, pool);
+	double threshold = own.cfg.risk_threshold;
+	Solution best = Solver::solve(own, sol, threshold, seed, pool);
+
+	{
+		lock_guard<mutex> lock(ctx.enrolled_lock);
+		lock_guard<mutex> own_lock(own.enrolled_lock);
+		for (unsigned int i = 0; i < own.enrolled.size(); i++)
+			ctx.enrolled.push_back(move(own.enrolled[i]));
+	}
+
+	/* Write results */
+	if (output) {
+		string path = string(output) + "/" + name + ".sol";
+		ofstream out(path.c_str());
+		if (!out) {
+			lock_guard<mutex> lock(writing);
+			cerr << "rcvrp: can not write " << path << '\n';
+			return false;
+		}
+		best.print(threshold, out);
+	} else {
+		ostringstream out;
+		out << "# " << name << '\n';
+		best.print(threshold, out);
+		lock_guard<mutex> lock(writing);
+		cout << out.str();
+	}
+	return true;
+}
+
+/*
+ * Make sure results can be written to an output directory before any
+ * instance is solved, creating it if missing.
+ */
+static void writable(char const *output)
+{
+	struct stat st;
+	if (mkdir(output, 0777) != 0 && errno != EEXIST)
+		throw runtime_error(string("can not create ") + output + ": " +
+			strerror(errno));
+	if (stat(output, &st) != 0 || !S_ISDIR(st.st_mode))
+		throw runtime_error(string(output) + " is not a directory");
+	if (access(output, W_OK | X_OK) != 0)
+		throw runtime_error(string("can not write to ") + output);
+}
+
+/*
+ * Solve many instances on a single pool, a few at once. Each one is prepared
+ * and solved by a task, whose restarts are tasks too, so small instances keep
+ * every worker busy.
+ */
+int batch(Context &ctx, char const *source, char const *output, Pool &pool)
+{
+	uint64_t seed = Solver::seed(ctx.cfg);
+	if (output)
+		writable(output);
+	Source src(source);
+	Flight flight;
+	mutex writing;
+	unsigned int limit = max(pool.size(), 2u);
+
+	/* The next instance is read while others are solved */
+	for (uint64_t k = 0;; k++) {
+		shared_ptr<Instance> inst = make_shared<Instance>(Instance{0.0, 0,
+			vector<unsigned int>{}, vector<Node>{}});
+		string name;
+		try {
+			if (!src.next(*inst, name))
+				break;
+		} catch (exception const &e) {
+			lock_guard<mutex> lock(writing);
+			cerr << "rcvrp: " << name << ": " << e.what() << '\n';
+			flight.fail();
+			continue;
+		}
+
+		flight.board(limit);
+		uint64_t s = Prng::derive(seed, k);
+		pool.submit([&ctx, &pool, &flight, &writing, inst, name, s,
+			output]() {
+			bool ok;
+			try {
+				ok = solve(ctx, *inst, name, s, output, pool, writing);
+			} catch (exception const &e) {
+				lock_guard<mutex> lock(writing);
+				cerr << "rcvrp: " << name << ": " << e.what() << '\n';
+				ok = false;
+			}
+			flight.land(!ok);
+		});
+	}
+	return flight.wait() ? 1 : 0;
+}
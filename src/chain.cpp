@@ -0,0 +1,82 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "chain.h"
+#include "solution.h"
+#include "telemetry.h"
+#include <cstdint>
+
+using std::uint64_t;
+
+/* Start a chain from an already tracked solution */
+Chain::Chain(Solution const &sol, uint64_t seed, Telemetry *_tm)
+	: best(sol)
+	, at_best(true)
+	, batch()
+	, curr(sol)
+	, best_cost(sol.cost())
+	, rng(seed)
+	, accepted(0)
+	, tm(_tm)
+{}
+
+/* Best solution so far */
+Solution const &Chain::snapshot(void)
+{
+	if (at_best) {
+		best = curr;
+		at_best = false;
+	}
+	return best;
+}
+
+/* Vehicles the best solution so far needs, without taking a snapshot */
+unsigned int Chain::best_fleet(void) const
+{
+	return at_best ? curr.fleet() : best.fleet();
+}
+
+/* Continue from another (better) solution */
+void Chain::restart(Solution const &sol, double cost)
+{
+	best = sol;
+	curr = sol;
+	best_cost = cost;
+	at_best = false;
+}
+
+/* Move to an accepted neighbor, tracking the best solution */
+void Chain::take(Move const &mv, double diff)
+{
+	curr.apply(mv);
+	accepted++;
+	if (tm)
+		tm->accept(mv, diff > 0.0);
+
+	/* And check if the new one is the best one so far */
+	if (curr.cost() <= best_cost) {
+		best_cost = curr.cost();
+		at_best = true;
+	} else if (at_best) {
+		/* Leaving the best solution, take a snapshot of it first */
+		curr.undo(mv);
+		best = curr;
+		curr.apply(mv);
+		at_best = false;
+	}
+}
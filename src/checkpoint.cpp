@@ -0,0 +1,81 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "checkpoint.h"
+#include "solution.h"
+#include <cstdio>
+#include <fstream>
+#include <ios>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+
+using dl = std::numeric_limits<double>;
+using std::cerr;
+using std::lock_guard;
+using std::mutex;
+using std::ofstream;
+using std::rename;
+using std::scientific;
+using std::string;
+
+/* Nothing kept yet */
+Checkpoint::Checkpoint(char const *_path, double threshold)
+	: path(_path)
+	, thr(threshold)
+	, lock()
+	, best()
+	, best_cost(dl::infinity())
+	, temperature(0.0)
+	, progress(0.0)
+{}
+
+/*
+ * Keep a solution if it is the best so far. Workers offer their best every
+ * now and then, so it is saved right away.
+ */
+void Checkpoint::offer(Solution const &sol, double cost, double _temperature,
+	double _progress)
+{
+	lock_guard<mutex> guard(lock);
+	if (!(cost < best_cost))
+		return;
+	best = sol;
+	best_cost = cost;
+	temperature = _temperature;
+	progress = _progress;
+	write();
+}
+
+/*
+ * Print the kept solution followed by the schedule state to a temporary file,
+ * then rename it over the checkpoint. A failure is reported, but the run goes
+ * on.
+ */
+void Checkpoint::write(void)
+{
+	string tmp = path + ".tmp";
+	ofstream out(tmp.c_str());
+	best.print(thr, out);
+	out << scientific << "# temperature " << temperature << '\n';
+	out << "# progress " << progress << '\n';
+	out.close();
+	if (!out || rename(tmp.c_str(), path.c_str()))
+		cerr << "rcvrp: can not write " << path << '\n';
+}
@@ -17,52 +17,270 @@
  */
 
 #include "config.h"
-#include <thread>
-#include <string>
+#include <algorithm>
+#include <cstddef>
 #include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
-using std::stof;
+using std::invalid_argument;
+using std::logic_error;
+using std::max;
+using std::stod;
+using std::size_t;
 using std::stoul;
 using std::thread;
 using std::string;
 using std::getenv;
 
-struct rcvrp_cfg ctx;
+/* Names of neighbor kinds, as given in NEIGHBORHOOD */
+static char const *const MOVE_NAMES[MOVES] = {
+	"flip", "kopt", "relocate", "oropt", "exchange", "twoopt"
+};
 
-void parse_cfg(int const argc, char const **argv)
+/* Variables read from the environment, in the order they are set */
+static char const *const VARIABLES[] = {
+	"MULTIPLIER", "TEMPERATURE", "ITERATIONS", "LOOPTIME", "BUDGET",
+	"THREADS", "CAPACITY", "DISTMEM", "SEED", "MIGRATION", "REPLICAS",
+	"AVGEXACT", "RESTARTS", "NEIGHBORS", "CANDIDATES", "TRACEEVERY",
+	"CHECKPOINTEVERY", "TELEMETRY", "ANYTIME", "NEIGHBORHOOD", "MODE",
+	"SCHEDULE", "PARTS", "ROUNDS", "PARTITION"
+};
+
+/* Value of a variable, which must be a whole number and nothing else */
+static unsigned long whole(string const &name, string const &v)
 {
-	/* "Use" unused parameters and avoid warnings */
-	(void)argc;
-	(void)argv;
+	size_t end = 0;
+	unsigned long n = 0;
+	try {
+		n = stoul(v, &end);
+	} catch (logic_error const &) {
+		end = 0;
+	}
+	if (!end || end != v.size())
+		throw invalid_argument("bad value of " + name);
+	return n;
+}
 
-	/* Set defaults configuration */
-	ctx.risk_threshold = 0.0;
-	ctx.temp_multiplier = 0.98;
-	ctx.temperature = 128.0;
-	ctx.max_iter = 128;
-	ctx.max_ms = 256;
-	ctx.v_cap = 0;
-	ctx.threads = thread::hardware_concurrency();
+/* Value of a variable, which must be a real number and nothing else */
+static double real(string const &name, string const &v)
+{
+	size_t end = 0;
+	double x = 0.0;
+	try {
+		x = stod(v, &end);
+	} catch (logic_error const &) {
+		end = 0;
+	}
+	if (!end || end != v.size())
+		throw invalid_argument("bad value of " + name);
+	return x;
+}
 
-	/* Parse environment variables and set user configuration */
-	if (getenv("MULTIPLIER"))
-		ctx.temp_multiplier = stof(getenv("MULTIPLIER"));
-	if (getenv("TEMPERATURE"))
-		ctx.temperature = stof(getenv("TEMPERATURE"));
-	if (getenv("ITERATIONS"))
-		ctx.max_iter = (unsigned int)stoul(getenv("ITERATIONS"));
-	if (getenv("LOOPTIME"))
-		ctx.max_ms = (unsigned int)stoul(getenv("LOOPTIME"));
-	if (getenv("THREADS"))
-		ctx.threads = (unsigned int)stoul(getenv("THREADS"));
-	if (getenv("CAPACITY"))
-		ctx.v_cap = (unsigned int)stoul(getenv("CAPACITY"));
+/*
+ * Parse comma separated name:weight pairs into the cumulative distribution
+ * of neighbor kinds. Missing kinds are never chosen.
+ */
+static void parse_mix(struct rcvrp_cfg &cfg, string const &spec)
+{
+	double weight[MOVES] = {0.0};
+	size_t at = 0;
+	while (at < spec.size()) {
+		size_t end = spec.find(',', at);
+		if (end == string::npos)
+			end = spec.size();
+		string item = spec.substr(at, end - at);
+		size_t colon = item.find(':');
+		string name = item.substr(0, colon);
+		unsigned int m = 0;
+		while (m < MOVES && name != MOVE_NAMES[m])
+			m++;
+		if (m == MOVES)
+			throw invalid_argument("unknown neighbor " + name);
+		weight[m] = colon == string::npos ? 1.0 :
+			real("weight for " + name, item.substr(colon + 1));
+		if (!(weight[m] >= 0.0))
+			throw invalid_argument("bad weight for " + name);
+		at = end + 1;
+	}
+
+	double sum = 0.0;
+	for (unsigned int m = 0; m < MOVES; m++)
+		sum += weight[m];
+	if (!(sum > 0.0))
+		throw invalid_argument("empty NEIGHBORHOOD");
+	double acc = 0.0;
+	for (unsigned int m = 0; m < MOVES; m++) {
+		acc += weight[m];
+		cfg.mix[m] = acc / sum;
+	}
+
+	/* No rounding may leave room for kinds after the last one chosen */
+	unsigned int last = MOVES;
+	while (!(weight[last - 1] > 0.0))
+		last--;
+	for (unsigned int m = last - 1; m < MOVES; m++)
+		cfg.mix[m] = 1.0;
+}
+
+/* Default configuration */
+void default_cfg(struct rcvrp_cfg &cfg)
+{
+	cfg.risk_threshold = 0.0;
+	cfg.temp_multiplier = 0.98;
+	cfg.temperature = 128.0;
+	cfg.max_iter = 128;
+	cfg.max_ms = 256;
+	cfg.budget = 0;
+	cfg.threads = thread::hardware_concurrency();
+	cfg.v_cap = 0;
+	cfg.dist_mem = 64;
+	cfg.seed = 0;
+	cfg.mode = MODE_INDEPENDENT;
+	cfg.schedule = SCHEDULE_AUTO;
+	cfg.migration = 8192;
+	cfg.replicas = 0;
+	cfg.avg_exact = 20000;
+	cfg.restarts = 0;
+	cfg.parts = 0;
+	cfg.rounds = 3;
+	cfg.partition = PARTITION_SWEEP;
+	parse_mix(cfg, "flip:1,kopt:0.2,relocate:1,oropt:1,exchange:1,twoopt:1");
+	cfg.neighbors = 8;
+	cfg.candidates = 1;
+	cfg.trace_every = 1024;
+	cfg.checkpoint_ms = 1000;
+	cfg.resume_temperature = 0.0;
+	cfg.resume_progress = 0.0;
+	cfg.telemetry = nullptr;
+	cfg.anytime = nullptr;
+	cfg.input = nullptr;
+	cfg.batch = nullptr;
+	cfg.output = nullptr;
+	cfg.start = nullptr;
+	cfg.checkpoint = nullptr;
+	cfg.delta = nullptr;
+	cfg.serve = nullptr;
+}
 
 /*
- * Override threads if benchmarking (many threads generate racing condition on)
- * stdout, which is unwanted.
+ * Set a variable, named as its environment variable. Paths are not copied,
+ * the value must outlive the configuration.
  */
-#if BENCHMARK
-	ctx.threads = 1;
-#endif
+void set_cfg(struct rcvrp_cfg &cfg, string const &name, char const *value)
+{
+	string v = value;
+	if (name == "MULTIPLIER")
+		cfg.temp_multiplier = (float)real(name, v);
+	else if (name == "TEMPERATURE")
+		cfg.temperature = (float)real(name, v);
+	else if (name == "ITERATIONS")
+		cfg.max_iter = (unsigned int)whole(name, v);
+	else if (name == "LOOPTIME")
+		cfg.max_ms = (unsigned int)whole(name, v);
+	else if (name == "BUDGET")
+		cfg.budget = whole(name, v);
+	else if (name == "THREADS")
+		cfg.threads = (unsigned int)whole(name, v);
+	else if (name == "CAPACITY")
+		cfg.v_cap = (unsigned int)whole(name, v);
+	else if (name == "DISTMEM")
+		cfg.dist_mem = (unsigned int)whole(name, v);
+	else if (name == "SEED")
+		cfg.seed = whole(name, v);
+	else if (name == "MIGRATION")
+		cfg.migration = max((unsigned int)whole(name, v), 1u);
+	else if (name == "REPLICAS")
+		cfg.replicas = (unsigned int)whole(name, v);
+	else if (name == "AVGEXACT")
+		cfg.avg_exact = (unsigned int)whole(name, v);
+	else if (name == "RESTARTS")
+		cfg.restarts = (unsigned int)whole(name, v);
+	else if (name == "PARTS")
+		cfg.parts = (unsigned int)whole(name, v);
+	else if (name == "ROUNDS")
+		cfg.rounds = max((unsigned int)whole(name, v), 1u);
+	else if (name == "NEIGHBORS")
+		cfg.neighbors = (unsigned int)whole(name, v);
+	else if (name == "CANDIDATES")
+		cfg.candidates = (unsigned int)whole(name, v);
+	else if (name == "TRACEEVERY")
+		cfg.trace_every = max((unsigned int)whole(name, v), 1u);
+	else if (name == "CHECKPOINTEVERY")
+		cfg.checkpoint_ms = (unsigned int)whole(name, v);
+	else if (name == "TELEMETRY")
+		cfg.telemetry = *value ? value : nullptr;
+	else if (name == "ANYTIME")
+		cfg.anytime = *value ? value : nullptr;
+	else if (name == "NEIGHBORHOOD")
+		parse_mix(cfg, v);
+	else if (name == "MODE" && v == "independent")
+		cfg.mode = MODE_INDEPENDENT;
+	else if (name == "MODE" && v == "island")
+		cfg.mode = MODE_ISLAND;
+	else if (name == "MODE" && v == "tempering")
+		cfg.mode = MODE_TEMPERING;
+	else if (name == "MODE" && v == "decompose")
+		cfg.mode = MODE_DECOMPOSE;
+	else if (name == "MODE")
+		throw invalid_argument("unknown MODE " + v);
+	else if (name == "SCHEDULE" && v == "auto")
+		cfg.schedule = SCHEDULE_AUTO;
+	else if (name == "SCHEDULE" && v == "fixed")
+		cfg.schedule = SCHEDULE_FIXED;
+	else if (name == "SCHEDULE")
+		throw invalid_argument("unknown SCHEDULE " + v);
+	else if (name == "PARTITION" && v == "sweep")
+		cfg.partition = PARTITION_SWEEP;
+	else if (name == "PARTITION" && v == "kmeans")
+		cfg.partition = PARTITION_KMEANS;
+	else if (name == "PARTITION")
+		throw invalid_argument("unknown PARTITION " + v);
+	else
+		throw invalid_argument("unknown variable " + name);
+}
+
+void parse_cfg(struct rcvrp_cfg &cfg, int const argc, char const **argv)
+{
+	default_cfg(cfg);
+
+	/*
+	 * Options are a batch source and an output directory, a solution to
+	 * start from, changes to make to the instance and a checkpoint file, or
+	 * where to serve requests. The only other argument is the instance
+	 * file, stdin if missing or "-".
+	 */
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if ((arg == "-b" || arg == "--batch") && i + 1 < argc)
+			cfg.batch = argv[++i];
+		else if ((arg == "-o" || arg == "--output") && i + 1 < argc)
+			cfg.output = argv[++i];
+		else if ((arg == "-s" || arg == "--start") && i + 1 < argc)
+			cfg.start = argv[++i];
+		else if ((arg == "-c" || arg == "--checkpoint") && i + 1 < argc)
+			cfg.checkpoint = argv[++i];
+		else if ((arg == "-d" || arg == "--delta") && i + 1 < argc)
+			cfg.delta = argv[++i];
+		else if ((arg == "-S" || arg == "--serve") && i + 1 < argc)
+			cfg.serve = argv[++i];
+		else if (cfg.input || (arg[0] == '-' && arg != "-"))
+			throw invalid_argument("unexpected argument " + arg);
+		else
+			cfg.input = argv[i];
+	}
+	if (cfg.batch && (cfg.start || cfg.checkpoint || cfg.delta))
+		throw invalid_argument("--start, --checkpoint and --delta need a "
+			"single instance");
+	if (cfg.delta && cfg.checkpoint)
+		throw invalid_argument("--delta solves too briefly to checkpoint");
+	if (cfg.serve && (cfg.batch || cfg.start || cfg.checkpoint || cfg.delta
+			|| cfg.input))
+		throw invalid_argument("--serve takes instances from requests");
+
+	/* Parse environment variables and set user configuration */
+	for (unsigned int i = 0; i < sizeof(VARIABLES) / sizeof(*VARIABLES); i++)
+		if (getenv(VARIABLES[i]))
+			set_cfg(cfg, VARIABLES[i], getenv(VARIABLES[i]));
 }
@@ -0,0 +1,71 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "context.h"
+#include "config.h"
+#include "distance.h"
+#include "telemetry.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using std::memory_order_relaxed;
+using std::mutex;
+using std::unique_ptr;
+using std::vector;
+
+/* Context for a configuration, without an instance yet */
+Context::Context(struct rcvrp_cfg const &_cfg)
+	: halt(false)
+	, cfg(_cfg)
+	, coords()
+	, demand()
+	, distance()
+	, avg_dist(0.0)
+	, near()
+	, near_k(0)
+	, parent(nullptr)
+	, halting(nullptr)
+	, enrolled_lock()
+	, enrolled()
+{}
+
+/* Records are complete types here */
+Context::~Context()
+{}
+
+/* Ask every worker to stop, safe from signal handlers */
+void Context::stop(void)
+{
+	halt.store(true, memory_order_relaxed);
+}
+
+/* Whether workers were asked to stop. Cheap, polled every iteration. */
+bool Context::stopped(void) const
+{
+	return halt.load(memory_order_relaxed)
+		|| (halting && halting->load(memory_order_relaxed))
+		|| (parent && parent->stopped());
+}
+
+/* Let workers of a later solve run again */
+void Context::resume(void)
+{
+	halt.store(false, memory_order_relaxed);
+}
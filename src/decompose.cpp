@@ -0,0 +1,275 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "decompose.h"
+#include "anytime.h"
+#include "checkpoint.h"
+#include "config.h"
+#include "context.h"
+#include "loader.h"
+#include "pool.h"
+#include "prng.h"
+#include "sa.h"
+#include "solution.h"
+#include "solver.h"
+#include "timer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <vector>
+
+using dl = std::numeric_limits<double>;
+using std::atan2;
+using std::floor;
+using std::future;
+using std::max;
+using std::min;
+using std::sort;
+using std::uint64_t;
+using std::vector;
+
+/* Nodes per part, unless the amount of parts is set */
+static unsigned int const PART_NODES = 1000;
+
+/* Nodes a part needs to be solved, smaller ones are kept as they are */
+static unsigned int const PART_MIN = 3;
+
+/* Lloyd iterations of k-means */
+static unsigned int const KMEANS_ROUNDS = 16;
+
+/* Route to be put in a part, by where its nodes are on average */
+struct Item {
+	double x;
+	double y;
+	double angle;
+	unsigned int size;
+};
+
+/*
+ * Routes sorted by angle around the deposit and cut into parts of about as
+ * many nodes each. Every round starts cutting half a part further along.
+ */
+static vector<unsigned int> sweep(vector<Item> const &items,
+	unsigned int parts, unsigned int round)
+{
+	unsigned int m = (unsigned int)items.size();
+	vector<unsigned int> order(m);
+	double nodes = 0.0;
+	for (unsigned int i = 0; i < m; i++) {
+		order[i] = i;
+		nodes += items[i].size;
+	}
+	sort(order.begin(), order.end(), [&items](unsigned int a,
+		unsigned int b) {
+		return items[a].angle < items[b].angle ||
+			(!(items[b].angle < items[a].angle) && a < b);
+	});
+
+	/* Each route goes to the part its middle node falls in */
+	double offset = nodes / parts * 0.5 * round;
+	vector<unsigned int> part(m);
+	double before = 0.0;
+	for (unsigned int i = 0; i < m; i++) {
+		Item const &it = items[order[i]];
+		double at = before + it.size * 0.5 + offset;
+		at -= nodes * floor(at / nodes);
+		part[order[i]] = min((unsigned int)(at / nodes * parts),
+			parts - 1);
+		before += it.size;
+	}
+	return part;
+}
+
+/*
+ * Routes clustered by k-means, weighted by their nodes, from centers drawn
+ * anew every round
+ */
+static vector<unsigned int> kmeans(vector<Item> const &items,
+	unsigned int parts, Prng &rng)
+{
+	unsigned int m = (unsigned int)items.size();
+	vector<double> cx(parts);
+	vector<double> cy(parts);
+	vector<unsigned int> pick(m);
+	for (unsigned int i = 0; i < m; i++)
+		pick[i] = i;
+	for (unsigned int c = 0; c < parts; c++) {
+		unsigned int j = c + rng.below(m - c);
+		unsigned int t = pick[c];
+		pick[c] = pick[j];
+		pick[j] = t;
+		cx[c] = items[pick[c]].x;
+		cy[c] = items[pick[c]].y;
+	}
+
+	vector<unsigned int> part(m, 0);
+	vector<double> sx(parts);
+	vector<double> sy(parts);
+	vector<double> w(parts);
+	for (unsigned int k = 0; k < KMEANS_ROUNDS; k++) {
+		/* Closest center of each route */
+		for (unsigned int i = 0; i < m; i++) {
+			double best = dl::infinity();
+			for (unsigned int c = 0; c < parts; c++) {
+				double dx = items[i].x - cx[c];
+				double dy = items[i].y - cy[c];
+				if (dx * dx + dy * dy < best) {
+					best = dx * dx + dy * dy;
+					part[i] = c;
+				}
+			}
+		}
+
+		/* Centers move to their routes, empty ones stay */
+		sx.assign(parts, 0.0);
+		sy.assign(parts, 0.0);
+		w.assign(parts, 0.0);
+		for (unsigned int i = 0; i < m; i++) {
+			sx[part[i]] += items[i].x * items[i].size;
+			sy[part[i]] += items[i].y * items[i].size;
+			w[part[i]] += items[i].size;
+		}
+		for (unsigned int c = 0; c < parts; c++) {
+			if (w[c] > 0.0) {
+				cx[c] = sx[c] / w[c];
+				cy[c] = sy[c] / w[c];
+			}
+		}
+	}
+	return part;
+}
+
+/* Split routes into parts, solve each one on a worker, put them together */
+Solution decompose(Context const &ctx, Solution sol, double risk,
+	uint64_t seed, Pool &pool, Checkpoint *saving, Anytime *stream)
+{
+	struct rcvrp_cfg const &cfg = ctx.cfg;
+	unsigned int n = (unsigned int)sol.perm.size();
+	unsigned int rounds = max(cfg.rounds, 1u);
+	Prng rng(seed);
+
+	/* Time spent splitting and joining parts, measured every round */
+	Timer timer;
+	double overhead = 0.0;
+
+	for (unsigned int round = 0; round < rounds && !ctx.stopped(); round++) {
+		double started = timer.elapsed();
+
+		/* Where routes are, at first most likely single nodes */
+		vector< vector<unsigned int> > routes = Solver::routes(sol);
+		unsigned int m = (unsigned int)routes.size();
+		vector<Item> items(m);
+		for (unsigned int r = 0; r < m; r++) {
+			double x = 0.0;
+			double y = 0.0;
+			for (unsigned int i = 0; i < routes[r].size(); i++) {
+				x += ctx.coords[routes[r][i]].x;
+				y += ctx.coords[routes[r][i]].y;
+			}
+			unsigned int size = (unsigned int)routes[r].size();
+			items[r] = Item{x / size, y / size, atan2(y, x), size};
+		}
+
+		/*
+		 * Routes are never joined across parts, so instances smaller than
+		 * a part are solved whole, and few enough parts are made for
+		 * each to have some nodes to solve
+		 */
+		unsigned int parts = cfg.parts ? cfg.parts : n < PART_NODES ? 1 :
+			max(pool.size(), (n + PART_NODES - 1) / PART_NODES);
+		parts = min(min(parts, m), max(n / PART_MIN, 1u));
+		vector<unsigned int> part = cfg.partition == PARTITION_KMEANS ?
+			kmeans(items, parts, rng) : sweep(items, parts, round);
+
+		vector< vector<unsigned int> > nodes(parts);
+		vector< vector< vector<unsigned int> > > pieces(parts);
+		for (unsigned int r = 0; r < m; r++) {
+			nodes[part[r]].insert(nodes[part[r]].end(),
+				routes[r].begin(), routes[r].end());
+			pieces[part[r]].push_back(routes[r]);
+		}
+
+		/*
+		 * Parts are solved in waves over the workers, sharing the time
+		 * left for this round, less the overhead of the last one, or a
+		 * share of the budget. Each round starts further along the
+		 * schedule.
+		 */
+		unsigned int waves = (parts + pool.size() - 1) / pool.size();
+		unsigned int left = rounds - round;
+		double ms = (cfg.max_ms - started) / left - overhead;
+		struct rcvrp_cfg sub = cfg;
+		sub.mode = MODE_INDEPENDENT;
+		sub.max_ms = ms > waves ? (unsigned int)(ms / waves) : 1u;
+		sub.budget = cfg.budget ? max(cfg.budget / rounds / waves, 1ul) :
+			0;
+		sub.resume_progress = cfg.resume_progress +
+			(1.0 - cfg.resume_progress) * round / rounds;
+		sub.checkpoint = nullptr;
+		sub.anytime = nullptr;
+		sub.telemetry = nullptr;
+
+		uint64_t base = Prng::derive(seed, round);
+		vector< future< vector< vector<unsigned int> > > > runs(parts);
+		for (unsigned int p = 0; p < parts; p++) {
+			runs[p] = pool.submit([&ctx, &sub, &nodes, &pieces, risk,
+				base, parts, p]() {
+				vector<unsigned int> const &own = nodes[p];
+				if (parts > 1 && own.size() < PART_MIN)
+					return pieces[p];
+				Context within(sub);
+				within.parent = &ctx;
+				Solution start = Solver::extract(ctx, own, pieces[p],
+					within);
+				Solution best = sa(within, start, risk,
+					Prng::derive(base, p), nullptr, nullptr,
+					nullptr);
+
+				/* Back to the numbering of the whole */
+				vector< vector<unsigned int> > solved =
+					Solver::routes(best);
+				for (unsigned int r = 0; r < solved.size(); r++)
+					for (unsigned int i = 0; i < solved[r].size();
+						i++)
+						solved[r][i] = own[solved[r][i]];
+				return solved;
+			});
+		}
+
+		/* Put solved parts together, in order */
+		Start whole{vector< vector<unsigned int> >{}, 0.0, 0.0};
+		for (unsigned int p = 0; p < parts; p++) {
+			vector< vector<unsigned int> > solved = pool.get(runs[p]);
+			whole.routes.insert(whole.routes.end(), solved.begin(),
+				solved.end());
+		}
+		Solver::warm(sol, whole, risk);
+		overhead = max(timer.elapsed() - started -
+			(double)sub.max_ms * waves, 0.0);
+
+		double cost = sol.eval(risk);
+		if (saving)
+			saving->offer(sol, cost, 0.0,
+				(double)(round + 1) / rounds);
+		if (stream)
+			stream->offer(cost, sol.fleet());
+	}
+	return sol;
+}
@@ -0,0 +1,119 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "distance.h"
+#include "node.h"
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+using std::size_t;
+using std::sqrt;
+using std::vector;
+
+/* Empty constructor */
+Distance::Distance()
+	: tier(COMPUTED)
+	, n(0)
+	, depot_dist()
+	, matrix()
+	, x()
+	, y()
+{}
+
+/* Precompute distances, storing as many as the memory budget allows */
+void Distance::build(vector<Node> const &coords, size_t budget)
+{
+	n = coords.size();
+
+	/* Coordinates are always kept in a compact layout */
+	x.resize(n);
+	y.resize(n);
+	depot_dist.resize(n);
+	for (size_t i = 0; i < n; i++) {
+		x[i] = coords[i].x;
+		y[i] = coords[i].y;
+		depot_dist[i] = sqrt(x[i] * x[i] + y[i] * y[i]);
+	}
+
+	/* Choose the biggest tier that fits */
+	size_t full = n * n * sizeof(double);
+	size_t tri = n * (n - 1) / 2 * sizeof(double);
+	if (n > 0 && full <= budget)
+		tier = FULL;
+	else if (n > 0 && tri <= budget)
+		tier = TRIANGULAR;
+	else
+		tier = COMPUTED;
+
+	/* Fill the matrix using on-the-fly distances */
+	matrix.clear();
+	switch (tier) {
+	case FULL:
+		matrix.resize(n * n);
+		for (size_t i = 0; i < n; i++) {
+			matrix[i * n + i] = 0.0;
+			for (size_t j = 0; j < i; j++) {
+				double dx = x[i] - x[j];
+				double dy = y[i] - y[j];
+				double d = sqrt(dx * dx + dy * dy);
+				matrix[i * n + j] = d;
+				matrix[j * n + i] = d;
+			}
+		}
+		break;
+	case TRIANGULAR:
+		matrix.resize(n * (n - 1) / 2);
+		for (size_t i = 1, k = 0; i < n; i++) {
+			for (size_t j = 0; j < i; j++, k++) {
+				double dx = x[i] - x[j];
+				double dy = y[i] - y[j];
+				matrix[k] = sqrt(dx * dx + dy * dy);
+			}
+		}
+		break;
+	case COMPUTED:
+	default:
+		break;
+	}
+	matrix.shrink_to_fit();
+}
+
+/* Tier in use */
+Distance::Tier Distance::kind(void) const
+{
+	return tier;
+}
+
+/* Amount of nodes */
+size_t Distance::size(void) const
+{
+	return n;
+}
+
+/* Abscissae of every node */
+double const *Distance::xs(void) const
+{
+	return x.data();
+}
+
+/* Ordinates of every node */
+double const *Distance::ys(void) const
+{
+	return y.data();
+}
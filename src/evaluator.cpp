@@ -0,0 +1,412 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "evaluator.h"
+#include "distance.h"
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EVALUATOR_X86
+#include <immintrin.h>
+#endif
+
+using dl = std::numeric_limits<double>;
+using std::sqrt;
+using std::vector;
+
+/*
+ * Steps of a solution in order, starting right after a route end. Step i is
+ * stored at i + 1, so kernels can look at the previous and next steps of any
+ * of them: money and route ends are padded in front as if a route just
+ * ended, and coordinates wrap around at the back.
+ */
+struct Steps {
+	vector<double> x;
+	vector<double> y;
+	vector<double> money;
+	vector<double> end;
+};
+
+/* Punishment parameters, and what is carried from one step to the next */
+struct Walk {
+	double thr;
+	double avg;
+	double cap;
+	double cost;
+	double money;
+	double risk;
+	bool over;
+};
+
+/* Gather n steps of nodes idx into s, from step at on */
+static void fill(Steps &s, Distance const &dist,
+	vector<unsigned int> const &demand, vector<bool> const &orig,
+	unsigned int const *idx, unsigned int n, unsigned int at)
+{
+	double const *xs = dist.xs();
+	double const *ys = dist.ys();
+	for (unsigned int i = 0; i < n; i++) {
+		unsigned int c = idx[i];
+		s.x[at + i + 1] = xs[c];
+		s.y[at + i + 1] = ys[c];
+		s.money[at + i + 1] = demand[c];
+		s.end[at + i + 1] = orig[c] ? 1.0 : 0.0;
+	}
+}
+
+#ifdef EVALUATOR_X86
+/* Same as fill, with coordinates and money loaded by vector gathers */
+__attribute__((target("avx2")))
+static void fill_avx2(Steps &s, Distance const &dist,
+	vector<unsigned int> const &demand, vector<bool> const &orig,
+	unsigned int const *idx, unsigned int n, unsigned int at)
+{
+	double const *xs = dist.xs();
+	double const *ys = dist.ys();
+	int const *money = (int const *)demand.data();
+	__m256d zero = _mm256_setzero_pd();
+	__m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+	unsigned int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i c = _mm_loadu_si128((__m128i const *)(idx + i));
+		_mm256_storeu_pd(&s.x[at + i + 1],
+			_mm256_mask_i32gather_pd(zero, xs, c, all, 8));
+		_mm256_storeu_pd(&s.y[at + i + 1],
+			_mm256_mask_i32gather_pd(zero, ys, c, all, 8));
+		_mm256_storeu_pd(&s.money[at + i + 1], _mm256_cvtepi32_pd(
+			_mm_mask_i32gather_epi32(_mm_setzero_si128(), money, c,
+			_mm_set1_epi32(-1), 4)));
+		for (unsigned int j = i; j < i + 4; j++)
+			s.end[at + j + 1] = orig[idx[j]] ? 1.0 : 0.0;
+	}
+	fill(s, dist, demand, orig, idx + i, n - i, at + i);
+}
+#endif
+
+/* Gather steps of a solution, reusing buffers of earlier calls */
+static Steps const &gather(Distance const &dist,
+	vector<unsigned int> const &demand, vector<unsigned int> const &perm,
+	vector<bool> const &orig, Evaluator::Isa isa)
+{
+	static thread_local Steps s{vector<double>{}, vector<double>{},
+		vector<double>{}, vector<double>{}};
+	unsigned int k = (unsigned int)perm.size();
+
+	s.x.resize(k + 2);
+	s.y.resize(k + 2);
+	s.money.resize(k + 2);
+	s.end.resize(k + 2);
+
+	/* Start from the deposit, wrapping around the permutation */
+	unsigned int st = 0;
+	while (!orig[perm[st++]]);
+	st %= k;
+#ifdef EVALUATOR_X86
+	if (isa == Evaluator::AVX2) {
+		fill_avx2(s, dist, demand, orig, &perm[st], k - st, 0);
+		fill_avx2(s, dist, demand, orig, &perm[0], st, k - st);
+	} else
+#endif
+	{
+		fill(s, dist, demand, orig, &perm[st], k - st, 0);
+		fill(s, dist, demand, orig, &perm[0], st, k - st);
+	}
+
+	s.x[0] = s.x[k];
+	s.y[0] = s.y[k];
+	s.money[0] = 0.0;
+	s.end[0] = 1.0;
+	s.x[k + 1] = s.x[1];
+	s.y[k + 1] = s.y[1];
+	s.money[k + 1] = 0.0;
+	s.end[k + 1] = 1.0;
+	return s;
+}
+
+/*
+ * Steps [from, to), one at a time. This is the order of summation of the
+ * original evaluation, and how vector kernels finish what does not fill a
+ * whole vector.
+ */
+static void walk(Steps const &s, unsigned int from, unsigned int to, Walk &w)
+{
+	for (unsigned int i = from + 1; i <= to; i++) {
+		double x = s.x[i];
+		double y = s.y[i];
+		bool end = s.end[i] > 0.0;
+
+		/* Check if coming from deposit */
+		if (s.end[i - 1] > 0.0) {
+			w.money = s.money[i];
+			w.risk = 0.0;
+			w.cost += sqrt(x * x + y * y);
+		} else {
+			w.money += s.money[i - 1];
+		}
+
+		/* Go back to deposit or to the next node */
+		double dist;
+		if (end) {
+			dist = sqrt(x * x + y * y);
+		} else {
+			double dx = x - s.x[i + 1];
+			double dy = y - s.y[i + 1];
+			dist = sqrt(dx * dx + dy * dy);
+		}
+		w.cost += dist;
+		w.risk += w.money * dist;
+
+		/* Money once this step is done, which is punished */
+		double carry = end ? w.money : w.money + s.money[i];
+		if (w.risk > w.thr)
+			w.cost += carry * w.avg;
+		if (carry > w.cap)
+			w.over = true;
+	}
+}
+
+#ifdef EVALUATOR_X86
+#ifdef __SSE2__
+/* Blend of a and b, taking b where mask is set */
+static inline __m128d select2(__m128d a, __m128d b, __m128d mask)
+{
+	return _mm_or_pd(_mm_and_pd(mask, b), _mm_andnot_pd(mask, a));
+}
+
+/*
+ * Inclusive scan of v restarting at lanes flagged in f, the lanes before
+ * the first flag continue from carry
+ */
+static inline __m128d scan2(__m128d v, __m128d f, __m128d carry)
+{
+	__m128d zero = _mm_setzero_pd();
+	v = _mm_add_pd(v, _mm_andnot_pd(f, _mm_unpacklo_pd(zero, v)));
+	f = _mm_or_pd(f, _mm_unpacklo_pd(zero, f));
+	return _mm_add_pd(v, _mm_andnot_pd(f, carry));
+}
+
+/* Two steps at a time */
+static void walk_sse2(Steps const &s, unsigned int k, Walk &w)
+{
+	__m128d zero = _mm_setzero_pd();
+	__m128d thr = _mm_set1_pd(w.thr);
+	__m128d avg = _mm_set1_pd(w.avg);
+	__m128d cap = _mm_set1_pd(w.cap);
+	__m128d money = zero;
+	__m128d risk = zero;
+	__m128d cost = zero;
+	__m128d over = zero;
+
+	unsigned int i = 0;
+	for (; i + 2 <= k; i += 2) {
+		__m128d x = _mm_loadu_pd(&s.x[i + 1]);
+		__m128d y = _mm_loadu_pd(&s.y[i + 1]);
+		__m128d dx = _mm_sub_pd(x, _mm_loadu_pd(&s.x[i + 2]));
+		__m128d dy = _mm_sub_pd(y, _mm_loadu_pd(&s.y[i + 2]));
+		__m128d d = _mm_loadu_pd(&s.money[i + 1]);
+		__m128d head = _mm_cmpneq_pd(_mm_loadu_pd(&s.end[i]), zero);
+		__m128d end = _mm_cmpneq_pd(_mm_loadu_pd(&s.end[i + 1]), zero);
+
+		/* Leg distances, back to the deposit at route ends */
+		__m128d depot = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(x, x),
+			_mm_mul_pd(y, y)));
+		__m128d next = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(dx, dx),
+			_mm_mul_pd(dy, dy)));
+		__m128d leg = select2(next, depot, end);
+
+		/* Money along each leg, then risk once it is done */
+		__m128d l = scan2(select2(_mm_loadu_pd(&s.money[i]), d, head),
+			head, money);
+		__m128d r = scan2(_mm_mul_pd(l, leg), head, risk);
+		__m128d m = _mm_add_pd(l, _mm_andnot_pd(end, d));
+
+		/* Distances, and punishments of steps over the threshold */
+		cost = _mm_add_pd(cost, _mm_add_pd(leg, _mm_and_pd(head, depot)));
+		cost = _mm_add_pd(cost, _mm_and_pd(_mm_cmpgt_pd(r, thr),
+			_mm_mul_pd(m, avg)));
+		over = _mm_or_pd(over, _mm_cmpgt_pd(m, cap));
+
+		money = _mm_unpackhi_pd(l, l);
+		risk = _mm_unpackhi_pd(r, r);
+	}
+
+	/* Leftover step, if any */
+	w.cost += _mm_cvtsd_f64(_mm_add_sd(cost, _mm_unpackhi_pd(cost, cost)));
+	w.money = _mm_cvtsd_f64(money);
+	w.risk = _mm_cvtsd_f64(risk);
+	w.over = w.over || _mm_movemask_pd(over);
+	walk(s, i, k, w);
+}
+#endif
+
+/* Lanes shifted up by 1 and by 2, zeros shifted in */
+__attribute__((target("avx2")))
+static inline __m256d up1(__m256d v)
+{
+	return _mm256_blend_pd(_mm256_permute4x64_pd(v, 0x90),
+		_mm256_setzero_pd(), 0x1);
+}
+
+__attribute__((target("avx2")))
+static inline __m256d up2(__m256d v)
+{
+	return _mm256_blend_pd(_mm256_permute4x64_pd(v, 0x40),
+		_mm256_setzero_pd(), 0x3);
+}
+
+/*
+ * Inclusive scan of v restarting at lanes flagged in f, the lanes before
+ * the first flag continue from carry
+ */
+__attribute__((target("avx2")))
+static inline __m256d scan4(__m256d v, __m256d f, __m256d carry)
+{
+	v = _mm256_add_pd(v, _mm256_andnot_pd(f, up1(v)));
+	f = _mm256_or_pd(f, up1(f));
+	v = _mm256_add_pd(v, _mm256_andnot_pd(f, up2(v)));
+	f = _mm256_or_pd(f, up2(f));
+	return _mm256_add_pd(v, _mm256_andnot_pd(f, carry));
+}
+
+/* Four steps at a time */
+__attribute__((target("avx2")))
+static void walk_avx2(Steps const &s, unsigned int k, Walk &w)
+{
+	__m256d zero = _mm256_setzero_pd();
+	__m256d thr = _mm256_set1_pd(w.thr);
+	__m256d avg = _mm256_set1_pd(w.avg);
+	__m256d cap = _mm256_set1_pd(w.cap);
+	__m256d money = zero;
+	__m256d risk = zero;
+	__m256d cost = zero;
+	__m256d over = zero;
+
+	unsigned int i = 0;
+	for (; i + 4 <= k; i += 4) {
+		__m256d x = _mm256_loadu_pd(&s.x[i + 1]);
+		__m256d y = _mm256_loadu_pd(&s.y[i + 1]);
+		__m256d dx = _mm256_sub_pd(x, _mm256_loadu_pd(&s.x[i + 2]));
+		__m256d dy = _mm256_sub_pd(y, _mm256_loadu_pd(&s.y[i + 2]));
+		__m256d d = _mm256_loadu_pd(&s.money[i + 1]);
+		__m256d head = _mm256_cmp_pd(_mm256_loadu_pd(&s.end[i]), zero,
+			_CMP_NEQ_OQ);
+		__m256d end = _mm256_cmp_pd(_mm256_loadu_pd(&s.end[i + 1]), zero,
+			_CMP_NEQ_OQ);
+
+		/* Leg distances, back to the deposit at route ends */
+		__m256d depot = _mm256_sqrt_pd(_mm256_add_pd(
+			_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)));
+		__m256d next = _mm256_sqrt_pd(_mm256_add_pd(
+			_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+		__m256d leg = _mm256_blendv_pd(next, depot, end);
+
+		/* Money along each leg, then risk once it is done */
+		__m256d l = scan4(_mm256_blendv_pd(
+			_mm256_loadu_pd(&s.money[i]), d, head), head, money);
+		__m256d r = scan4(_mm256_mul_pd(l, leg), head, risk);
+		__m256d m = _mm256_add_pd(l, _mm256_andnot_pd(end, d));
+
+		/* Distances, and punishments of steps over the threshold */
+		cost = _mm256_add_pd(cost, _mm256_add_pd(leg,
+			_mm256_and_pd(head, depot)));
+		cost = _mm256_add_pd(cost, _mm256_and_pd(
+			_mm256_cmp_pd(r, thr, _CMP_GT_OQ), _mm256_mul_pd(m, avg)));
+		over = _mm256_or_pd(over, _mm256_cmp_pd(m, cap, _CMP_GT_OQ));
+
+		money = _mm256_permute4x64_pd(l, 0xff);
+		risk = _mm256_permute4x64_pd(r, 0xff);
+	}
+
+	/* Leftover steps, if any */
+	__m128d half = _mm_add_pd(_mm256_castpd256_pd128(cost),
+		_mm256_extractf128_pd(cost, 1));
+	w.cost += _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+	w.money = _mm256_cvtsd_f64(money);
+	w.risk = _mm256_cvtsd_f64(risk);
+	w.over = w.over || _mm256_movemask_pd(over);
+	walk(s, i, k, w);
+}
+#endif
+
+/* Best instruction set this CPU supports, detected once */
+Evaluator::Isa Evaluator::best(void)
+{
+	static Isa const isa = []() {
+#ifdef EVALUATOR_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return AVX2;
+#ifdef __SSE2__
+		return SSE2;
+#endif
+#endif
+		return SCALAR;
+	}();
+	return isa;
+}
+
+/* Printable name of an instruction set */
+char const *Evaluator::name(Isa isa)
+{
+	switch (isa) {
+	case AVX2:
+		return "avx2";
+	case SSE2:
+		return "sse2";
+	case SCALAR:
+	default:
+		return "scalar";
+	}
+}
+
+/* Cost of a solution, infinite if over capacity (0 means unlimited) */
+double Evaluator::eval(Distance const &dist, vector<unsigned int> const &demand,
+	vector<unsigned int> const &perm, vector<bool> const &orig,
+	double threshold, double avg_dist, unsigned int v_cap, Isa isa)
+{
+	unsigned int k = (unsigned int)perm.size();
+
+	/* Never use what this CPU lacks */
+	if (isa > best())
+		isa = best();
+
+	Steps const &s = gather(dist, demand, perm, orig, isa);
+	Walk w{threshold, avg_dist, v_cap ? (double)v_cap : dl::infinity(),
+		0.0, 0.0, 0.0, false};
+	switch (isa) {
+	case AVX2:
+#ifdef EVALUATOR_X86
+		walk_avx2(s, k, w);
+		break;
+#endif
+	case SSE2:
+#if defined(EVALUATOR_X86) && defined(__SSE2__)
+		walk_sse2(s, k, w);
+		break;
+#endif
+	case SCALAR:
+	default:
+		walk(s, 0, k, w);
+		break;
+	}
+
+	/* If solution exceeds vehicle capacity, punish with infinity */
+	return w.over ? dl::infinity() : w.cost;
+}
@@ -0,0 +1,69 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "exchange.h"
+#include "solution.h"
+#include <atomic>
+#include <limits>
+#include <memory>
+
+using dl = std::numeric_limits<double>;
+using std::atomic_compare_exchange_strong;
+using std::atomic_load;
+using std::make_shared;
+using std::memory_order_relaxed;
+using std::shared_ptr;
+
+/* Empty slot */
+Exchange::Exchange()
+	: slot()
+	, hint(dl::infinity())
+{}
+
+/* Cost of the published solution. Cheap, meant to be polled often. */
+double Exchange::cost(void) const
+{
+	return hint.load(memory_order_relaxed);
+}
+
+/* Publish a solution, unless an equal or better one is already there */
+bool Exchange::publish(Solution const &sol, double cost)
+{
+	/* Avoid copying the solution if it would lose anyway */
+	if (!(cost < hint.load(memory_order_relaxed)))
+		return false;
+
+	shared_ptr<Snapshot const> mine = make_shared<Snapshot const>(
+		Snapshot{cost, sol});
+	shared_ptr<Snapshot const> curr = atomic_load(&slot);
+	do {
+		if (curr && !(cost < curr->cost))
+			return false;
+	} while (!atomic_compare_exchange_strong(&slot, &curr, mine));
+
+	/* Only the hint may lag behind, the slot is always consistent */
+	double h = hint.load(memory_order_relaxed);
+	while (cost < h && !hint.compare_exchange_weak(h, cost));
+	return true;
+}
+
+/* Get the published solution, possibly empty */
+shared_ptr<Snapshot const> Exchange::fetch(void) const
+{
+	return atomic_load(&slot);
+}
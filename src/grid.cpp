@@ -0,0 +1,226 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "grid.h"
+#include "node.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+using dl = std::numeric_limits<double>;
+using std::make_pair;
+using std::max;
+using std::min;
+using std::pair;
+using std::pop_heap;
+using std::push_heap;
+using std::sort_heap;
+using std::sqrt;
+using std::swap;
+using std::vector;
+
+/* Average amount of nodes per cell */
+static double const NODES_PER_CELL = 2.0;
+
+/* Build the grid, every node starts alive */
+Grid::Grid(vector<Node> const &_coords)
+	: coords(_coords)
+	, min_x(0.0)
+	, min_y(0.0)
+	, side(1.0)
+	, cols(1)
+	, rows(1)
+	, start()
+	, alive()
+	, nodes()
+	, slot()
+	, remaining((unsigned int)_coords.size())
+{
+	unsigned int n = (unsigned int)coords.size();
+	if (!n)
+		return;
+
+	/* Bounding box */
+	double max_x = coords[0].x;
+	double max_y = coords[0].y;
+	min_x = coords[0].x;
+	min_y = coords[0].y;
+	for (unsigned int i = 1; i < n; i++) {
+		min_x = min(min_x, coords[i].x);
+		min_y = min(min_y, coords[i].y);
+		max_x = max(max_x, coords[i].x);
+		max_y = max(max_y, coords[i].y);
+	}
+
+	/* Square cells, sized for a few nodes each */
+	double w = max(max_x - min_x, dl::min());
+	double h = max(max_y - min_y, dl::min());
+	side = sqrt(w * h * NODES_PER_CELL / n);
+	if (!(side > 0.0))
+		side = max(w, h);
+	cols = min((unsigned int)(w / side) + 1, n);
+	rows = min((unsigned int)(h / side) + 1, n);
+
+	/* Counting sort of nodes by cell */
+	start.assign(cols * rows + 1, 0);
+	for (unsigned int i = 0; i < n; i++)
+		start[row(coords[i].y) * cols + col(coords[i].x) + 1]++;
+	for (unsigned int c = 0; c < cols * rows; c++)
+		start[c + 1] += start[c];
+	alive.assign(start.begin(), start.end() - 1);
+	nodes.resize(n);
+	slot.resize(n);
+	for (unsigned int i = 0; i < n; i++) {
+		unsigned int c = row(coords[i].y) * cols + col(coords[i].x);
+		slot[i] = alive[c]++;
+		nodes[slot[i]] = i;
+	}
+}
+
+/* Column of a x coordinate */
+unsigned int Grid::col(double x) const
+{
+	return min((unsigned int)((x - min_x) / side), cols - 1);
+}
+
+/* Row of a y coordinate */
+unsigned int Grid::row(double y) const
+{
+	return min((unsigned int)((y - min_y) / side), rows - 1);
+}
+
+/* Remove a node from further queries, swapping it past its cell end */
+void Grid::erase(unsigned int node)
+{
+	unsigned int c = row(coords[node].y) * cols + col(coords[node].x);
+	unsigned int last = --alive[c];
+	unsigned int other = nodes[last];
+
+	swap(nodes[slot[node]], nodes[last]);
+	swap(slot[node], slot[other]);
+	remaining--;
+}
+
+/* Closest remaining node to a node, searching rings of cells around it */
+unsigned int Grid::nearest(unsigned int node) const
+{
+	unsigned int n = (unsigned int)coords.size();
+	unsigned int best = n;
+	double best_d2 = dl::infinity();
+	if (!remaining)
+		return best;
+
+	double x = coords[node].x;
+	double y = coords[node].y;
+	int cx = (int)col(x);
+	int cy = (int)row(y);
+	int reach = (int)max(cols, rows);
+
+	for (int r = 0; r <= reach; r++) {
+		/* Nodes beyond this ring are at least r cells away */
+		double bound = (r - 1) * side;
+		if (r > 0 && bound > 0.0 && best_d2 <= bound * bound)
+			break;
+
+		for (int j = cy - r; j <= cy + r; j++) {
+			if (j < 0 || j >= (int)rows)
+				continue;
+			/* Only the border of the ring is new */
+			int step = (j == cy - r || j == cy + r) ? 1 : 2 * r;
+			for (int i = cx - r; i <= cx + r; i += step) {
+				if (i < 0 || i >= (int)cols)
+					continue;
+				unsigned int c = (unsigned int)j * cols + (unsigned int)i;
+				for (unsigned int s = start[c]; s < alive[c]; s++) {
+					Node const &p = coords[nodes[s]];
+					double d2 = (p.x - x) * (p.x - x)
+						+ (p.y - y) * (p.y - y);
+					if (d2 < best_d2) {
+						best_d2 = d2;
+						best = nodes[s];
+					}
+				}
+			}
+		}
+	}
+	return best;
+}
+
+/*
+ * Up to k closest remaining nodes to a node, other than it, closest first.
+ * Rings of cells are searched until the farthest of the k found so far is
+ * closer than any cell left.
+ */
+void Grid::nearest(unsigned int node, unsigned int k,
+	vector<unsigned int> &out) const
+{
+	vector< pair<double, unsigned int> > heap;
+	heap.reserve(k + 1);
+	out.clear();
+	if (!k)
+		return;
+
+	double x = coords[node].x;
+	double y = coords[node].y;
+	int cx = (int)col(x);
+	int cy = (int)row(y);
+	int reach = (int)max(cols, rows);
+
+	for (int r = 0; r <= reach; r++) {
+		/* Nodes beyond this ring are at least r cells away */
+		double bound = (r - 1) * side;
+		if (r > 0 && bound > 0.0 && heap.size() == k
+			&& heap.front().first <= bound * bound)
+			break;
+
+		for (int j = cy - r; j <= cy + r; j++) {
+			if (j < 0 || j >= (int)rows)
+				continue;
+			/* Only the border of the ring is new */
+			int step = (j == cy - r || j == cy + r) ? 1 : 2 * r;
+			for (int i = cx - r; i <= cx + r; i += step) {
+				if (i < 0 || i >= (int)cols)
+					continue;
+				unsigned int c = (unsigned int)j * cols + (unsigned int)i;
+				for (unsigned int s = start[c]; s < alive[c]; s++) {
+					if (nodes[s] == node)
+						continue;
+					Node const &p = coords[nodes[s]];
+					double d2 = (p.x - x) * (p.x - x)
+						+ (p.y - y) * (p.y - y);
+
+					/* Keep the k closest in a max heap */
+					if (heap.size() < k || d2 < heap.front().first) {
+						heap.push_back(make_pair(d2, nodes[s]));
+						push_heap(heap.begin(), heap.end());
+						if (heap.size() > k) {
+							pop_heap(heap.begin(), heap.end());
+							heap.pop_back();
+						}
+					}
+				}
+			}
+		}
+	}
+
+	sort_heap(heap.begin(), heap.end());
+	for (unsigned int i = 0; i < heap.size(); i++)
+		out.push_back(heap[i].second);
+}
@@ -17,50 +17,157 @@
  */
 
 #include "heuristic.h"
+#include "distance.h"
+#include "grid.h"
 #include "node.h"
-#include "geometry.h"
-#include <vector>
-#include <limits>
+#include "pool.h"
+#include "prng.h"
 #include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <future>
+#include <vector>
 
-using std::swap;
+using std::atomic;
+using std::future;
+using std::max;
+using std::min;
+using std::size_t;
 using std::vector;
-using dl = std::numeric_limits<double>;
 
-/* Pseudo prim for initial solutions */
-void Heuristic::prim(vector<Node> &coords, vector<unsigned int> &perm)
+/* Side of the tiles of node pairs summed together */
+static unsigned int const TILE = 256;
+
+/* Pairs sampled at once, and at most, when estimating average distance */
+static unsigned int const SAMPLE_BATCH = 4096;
+static unsigned int const SAMPLE_MAX = 1u << 26;
+
+/*
+ * Pseudo prim for initial solutions. Nearest remaining nodes are found
+ * through a spatial grid, so it runs in about n log n.
+ */
+void Heuristic::prim(vector<Node> const &coords, vector<unsigned int> &perm)
 {
+	if (perm.empty())
+		return;
+
+	/* Start from the first node */
+	Grid grid(coords);
+	grid.erase(perm.at(0));
+
 	/* For each node, set the next neighbor as the closest remaining node */
-	for (unsigned int i = 0; i < perm.size() - 1; i++) {
-		unsigned int best_node = (unsigned int)perm.size() - 1;
-		double best_dist = dl::infinity();
-		for (unsigned int j = i + 1; j < perm.size(); j++) {
-			Node &a = coords.at(perm.at(i));
-			Node &b = coords.at(perm.at(j));
-			if (Geometry::dist(a, b) < best_dist) {
-				best_dist = Geometry::dist(a, b);
-				best_node = j;
-			}
-		}
-		swap(perm.at(i + 1), perm.at(best_node));
+	for (unsigned int i = 1; i < perm.size(); i++) {
+		perm.at(i) = grid.nearest(perm.at(i - 1));
+		grid.erase(perm.at(i));
+	}
+}
+
+/*
+ * The k nearest nodes of every node, closest first, one list after the other.
+ * There must be more than k nodes.
+ */
+vector<unsigned int> Heuristic::neighbors(vector<Node> const &coords,
+	unsigned int k)
+{
+	unsigned int n = (unsigned int)coords.size();
+	vector<unsigned int> near;
+	vector<unsigned int> found;
+	near.reserve((size_t)n * k);
+
+	Grid grid(coords);
+	for (unsigned int i = 0; i < n; i++) {
+		grid.nearest(i, k, found);
+		near.insert(near.end(), found.begin(), found.end());
 	}
+	return near;
 }
 
-/* Get average distance between every node */
-double Heuristic::avg_dist(vector<Node> &coords)
+/*
+ * Get average distance between every node, deposit included. Pairs are
+ * summed in cache sized tiles spread over a pool. Tile sums are added in a
+ * fixed order, so the result does not depend on scheduling.
+ */
+double Heuristic::avg_dist(Distance const &dist, Pool &pool)
 {
-	unsigned int N = (unsigned int)coords.size();
+	unsigned int N = (unsigned int)dist.size();
 	double total = 0.0;
 
 	/* Distances to origin */
-	Node origin{0, 0};
 	for (unsigned int i = 0; i <  N; i++)
-		total += Geometry::dist(coords.at(i), origin);
+		total += dist.depot(i);
+
+	/* Tiles (bi, bj) of the upper triangle, bi <= bj */
+	unsigned int blocks = (N + TILE - 1) / TILE;
+	vector<unsigned int> tile_i;
+	vector<unsigned int> tile_j;
+	for (unsigned int bi = 0; bi < blocks; bi++) {
+		for (unsigned int bj = bi; bj < blocks; bj++) {
+			tile_i.push_back(bi);
+			tile_j.push_back(bj);
+		}
+	}
+	vector<double> partial(tile_i.size(), 0.0);
+	atomic<unsigned int> next(0);
+
+	/* Distances among nodes, each task takes tiles until none is left */
+	auto worker = [&]() {
+		unsigned int t;
+		while ((t = next++) < partial.size()) {
+			unsigned int i0 = tile_i[t] * TILE;
+			unsigned int j0 = tile_j[t] * TILE;
+			unsigned int i1 = min(i0 + TILE, N);
+			unsigned int j1 = min(j0 + TILE, N);
+			double sum = 0.0;
+			for (unsigned int i = i0; i < i1; i++)
+				for (unsigned int j = max(j0, i + 1); j < j1; j++)
+					sum += dist(i, j);
+			partial[t] = sum;
+		}
+	};
+	unsigned int tasks = min(pool.size(), (unsigned int)partial.size());
+	vector< future<void> > runs(tasks);
+	for (unsigned int i = 0; i < tasks; i++)
+		runs[i] = pool.submit(worker);
+	for (unsigned int i = 0; i < tasks; i++)
+		pool.get(runs[i]);
 
-	/* Distances among nodes */
-	for (unsigned int i = 0; i < N - 1; i++)
-		for (unsigned int j = i + 1; j < N; j++)
-			total += Geometry::dist(coords.at(i), coords.at(j));
+	for (unsigned int t = 0; t < partial.size(); t++)
+		total += partial[t];
+	return total / (N + (double)N * (N - 1) / 2);
+}
+
+/*
+ * Estimate the average distance between every node by sampling random
+ * pairs, until the standard error is below some fraction of the mean.
+ * Distances to the deposit are still summed exactly.
+ */
+double Heuristic::avg_dist_sampled(Distance const &dist, double tolerance)
+{
+	unsigned int N = (unsigned int)dist.size();
+	double depot = 0.0;
+	for (unsigned int i = 0; i < N; i++)
+		depot += dist.depot(i);
+	if (N < 2)
+		return N ? depot / N : 0.0;
+
+	/* Fixed seed, the same instance always gets the same estimate */
+	Prng rng(N);
+	double sum = 0.0;
+	double sum2 = 0.0;
+	unsigned int m = 0;
+	do {
+		for (unsigned int s = 0; s < SAMPLE_BATCH; s++) {
+			unsigned int i = rng.below(N);
+			unsigned int j = rng.below(N - 1);
+			double d = dist(i, j < i ? j : j + 1);
+			sum += d;
+			sum2 += d * d;
+		}
+		m += SAMPLE_BATCH;
+	} while (m < SAMPLE_MAX
+		&& (sum2 / m - (sum / m) * (sum / m)) / m
+		> tolerance * tolerance * (sum / m) * (sum / m));
 
-	return total / (N + (N * (N - 1) / 2));
+	double pairs = (double)N * (N - 1) / 2;
+	return (depot + sum / m * pairs) / (N + pairs);
 }
@@ -0,0 +1,240 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "json.h"
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using std::invalid_argument;
+using std::snprintf;
+using std::string;
+using std::vector;
+
+/* Values nested deeper are rejected, so parsing never runs out of stack */
+static unsigned int const MAX_DEPTH = 64;
+
+Json::Json(void)
+	: kind(NUL)
+	, text()
+	, keys()
+	, items()
+{}
+
+/* Member of an object, null if missing */
+Json const *Json::get(string const &key) const
+{
+	if (kind != OBJECT)
+		return nullptr;
+	for (unsigned int i = 0; i < keys.size(); i++)
+		if (keys[i] == key)
+			return &items[i];
+	return nullptr;
+}
+
+static void blank(char const *&p, char const *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+		p++;
+}
+
+static void expect(char const *&p, char const *end, char c)
+{
+	blank(p, end);
+	if (p == end || *p != c)
+		throw invalid_argument(string("bad JSON, expected ") + c);
+	p++;
+}
+
+/* Append a code point as UTF-8 */
+static void utf8(string &out, unsigned long c)
+{
+	if (c < 0x80) {
+		out += (char)c;
+	} else if (c < 0x800) {
+		out += (char)(0xc0 | (c >> 6));
+		out += (char)(0x80 | (c & 0x3f));
+	} else if (c < 0x10000) {
+		out += (char)(0xe0 | (c >> 12));
+		out += (char)(0x80 | ((c >> 6) & 0x3f));
+		out += (char)(0x80 | (c & 0x3f));
+	} else {
+		out += (char)(0xf0 | (c >> 18));
+		out += (char)(0x80 | ((c >> 12) & 0x3f));
+		out += (char)(0x80 | ((c >> 6) & 0x3f));
+		out += (char)(0x80 | (c & 0x3f));
+	}
+}
+
+/* Four hexadecimal digits of a \u escape */
+static unsigned long hex(char const *&p, char const *end)
+{
+	if (end - p < 4)
+		throw invalid_argument("bad JSON escape");
+	unsigned long c = 0;
+	for (unsigned int i = 0; i < 4; i++, p++) {
+		c <<= 4;
+		if (*p >= '0' && *p <= '9')
+			c |= (unsigned long)(*p - '0');
+		else if (*p >= 'a' && *p <= 'f')
+			c |= (unsigned long)(*p - 'a' + 10);
+		else if (*p >= 'A' && *p <= 'F')
+			c |= (unsigned long)(*p - 'A' + 10);
+		else
+			throw invalid_argument("bad JSON escape");
+	}
+	return c;
+}
+
+/* String contents, p right after the opening quote */
+static string unquote(char const *&p, char const *end)
+{
+	string out;
+	for (;;) {
+		if (p == end)
+			throw invalid_argument("bad JSON, unterminated string");
+		char c = *p++;
+		if (c == '"')
+			return out;
+		if (c != '\\') {
+			out += c;
+			continue;
+		}
+		if (p == end)
+			throw invalid_argument("bad JSON escape");
+		switch (*p++) {
+		case 'b': out += '\b'; break;
+		case 'f': out += '\f'; break;
+		case 'n': out += '\n'; break;
+		case 'r': out += '\r'; break;
+		case 't': out += '\t'; break;
+		case 'u': {
+			unsigned long u = hex(p, end);
+
+			/* Surrogate pairs make a single code point */
+			if (u >= 0xd800 && u < 0xdc00 && end - p >= 6 &&
+					p[0] == '\\' && p[1] == 'u') {
+				p += 2;
+				u = 0x10000 + ((u - 0xd800) << 10) +
+					(hex(p, end) - 0xdc00);
+			}
+			utf8(out, u);
+			break;
+		}
+		default: out += p[-1]; break;
+		}
+	}
+}
+
+static Json value(char const *&p, char const *end, unsigned int depth)
+{
+	if (depth > MAX_DEPTH)
+		throw invalid_argument("bad JSON, too deep");
+
+	Json v;
+	blank(p, end);
+	if (p == end)
+		throw invalid_argument("bad JSON, value expected");
+
+	if (*p == '{' || *p == '[') {
+		bool object = *p == '{';
+		char close = object ? '}' : ']';
+		v.kind = object ? Json::OBJECT : Json::ARRAY;
+		p++;
+		blank(p, end);
+		if (p < end && *p == close) {
+			p++;
+			return v;
+		}
+		for (;;) {
+			if (object) {
+				expect(p, end, '"');
+				v.keys.push_back(unquote(p, end));
+				expect(p, end, ':');
+			}
+			v.items.push_back(value(p, end, depth + 1));
+			blank(p, end);
+			if (p < end && *p == ',') {
+				p++;
+				continue;
+			}
+			expect(p, end, close);
+			return v;
+		}
+	}
+
+	if (*p == '"') {
+		p++;
+		v.kind = Json::STRING;
+		v.text = unquote(p, end);
+		return v;
+	}
+
+	/* Numbers and literals are kept as written */
+	char const *from = p;
+	while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' &&
+			*p != '\t' && *p != '\n' && *p != '\r')
+		p++;
+	v.text.assign(from, p);
+	if (v.text == "null")
+		v.kind = Json::NUL;
+	else if (v.text == "true" || v.text == "false")
+		v.kind = Json::BOOL;
+	else if (v.text.find_first_not_of("0123456789+-.eE") == string::npos &&
+			!v.text.empty())
+		v.kind = Json::NUMBER;
+	else
+		throw invalid_argument("bad JSON value " + v.text);
+	return v;
+}
+
+/* Parse a whole value, surrounded by whitespace only */
+Json Json::parse(char const *begin, char const *end)
+{
+	char const *p = begin;
+	Json v = value(p, end, 0);
+	blank(p, end);
+	if (p != end)
+		throw invalid_argument("bad JSON, trailing characters");
+	return v;
+}
+
+/* Quoted and escaped string */
+string Json::quote(string const &s)
+{
+	string out = "\"";
+	for (unsigned int i = 0; i < s.size(); i++) {
+		unsigned char c = (unsigned char)s[i];
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += (char)c;
+		} else if (c == '\n') {
+			out += "\\n";
+		} else if (c == '\t') {
+			out += "\\t";
+		} else if (c < 0x20) {
+			char u[8];
+			snprintf(u, sizeof(u), "\\u%04x", c);
+			out += u;
+		} else {
+			out += (char)c;
+		}
+	}
+	return out + "\"";
+}
@@ -0,0 +1,436 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "loader.h"
+#include "node.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using dl = std::numeric_limits<double>;
+using std::fread;
+using std::getline;
+using std::ifstream;
+using std::istringstream;
+using std::runtime_error;
+using std::size_t;
+using std::stod;
+using std::strcmp;
+using std::strtod;
+using std::strtoul;
+using std::string;
+using std::uint64_t;
+using std::vector;
+
+/* Exactly representable powers of ten */
+static double const POW10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* Cursor over an in-memory input */
+class Scanner {
+private:
+	char const *p;
+	char const *end;
+public:
+	Scanner(char const *_p, char const *_end)
+		: p(_p)
+		, end(_end)
+	{}
+
+	/* Current position */
+	char const *at(void) const
+	{
+		return p;
+	}
+
+	/* Skip blanks, return whether anything is left */
+	bool more(void)
+	{
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\n'
+			|| *p == '\r' || *p == ':'))
+			p++;
+		return p < end;
+	}
+
+	/* Peek next character */
+	char peek(void)
+	{
+		return more() ? *p : '\0';
+	}
+
+	/* Next word, up to a blank or a colon */
+	string word(void)
+	{
+		more();
+		char const *st = p;
+		while (p < end && *p != ' ' && *p != '\t' && *p != '\n'
+			&& *p != '\r' && *p != ':')
+			p++;
+		return string(st, p);
+	}
+
+	/* Rest of the current line */
+	string line(void)
+	{
+		more();
+		char const *st = p;
+		while (p < end && *p != '\n' && *p != '\r')
+			p++;
+		return string(st, p);
+	}
+
+	/* Unsigned integer */
+	unsigned int uint(void)
+	{
+		if (!more() || *p < '0' || *p > '9')
+			throw runtime_error("expected an unsigned integer");
+		uint64_t v = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+			v = v * 10 + (uint64_t)(*p++ - '0');
+		if (v > 0xffffffffu)
+			throw runtime_error("integer out of range");
+		return (unsigned int)v;
+	}
+
+	/*
+	 * Real number. Mantissas below 2^53 with small exponents are converted
+	 * exactly, anything else is left to strtod.
+	 */
+	double real(void)
+	{
+		if (!more())
+			throw runtime_error("expected a number");
+		char const *st = p;
+		bool neg = false;
+		if (*p == '-' || *p == '+')
+			neg = *p++ == '-';
+
+		uint64_t m = 0;
+		int digits = 0;
+		int exp = 0;
+		while (p < end && *p >= '0' && *p <= '9') {
+			if (digits < 19)
+				m = m * 10 + (uint64_t)(*p - '0');
+			else
+				exp++;
+			digits += m > 0;
+			p++;
+		}
+		if (p < end && *p == '.') {
+			p++;
+			while (p < end && *p >= '0' && *p <= '9') {
+				if (digits < 19) {
+					m = m * 10 + (uint64_t)(*p - '0');
+					exp--;
+				}
+				digits += m > 0;
+				p++;
+			}
+		}
+		if (p == st || (p == st + 1 && (*st == '-' || *st == '+')))
+			throw runtime_error("expected a number");
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			char const *e = p++;
+			bool eneg = false;
+			if (p < end && (*p == '-' || *p == '+'))
+				eneg = *p++ == '-';
+			int ev = 0;
+			if (p >= end || *p < '0' || *p > '9')
+				p = e;
+			while (p < end && *p >= '0' && *p <= '9' && ev < 10000)
+				ev = ev * 10 + (*p++ - '0');
+			exp += eneg ? -ev : ev;
+		}
+
+		double v;
+		if (m < (UINT64_C(1) << 53) && exp >= -22 && exp <= 22) {
+			v = (double)m;
+			v = exp < 0 ? v / POW10[-exp] : v * POW10[exp];
+		} else {
+			/* Slow path, on a NUL terminated copy of the token */
+			char buf[128];
+			size_t len = (size_t)(p - st);
+			if (len >= sizeof(buf))
+				throw runtime_error("number too long");
+			memcpy(buf, st, len);
+			buf[len] = '\0';
+			return strtod(buf, nullptr);
+		}
+		return neg ? -v : v;
+	}
+};
+
+/* Plain format: nodes, threshold, demands and coordinates */
+static Instance parse_plain(Scanner &in)
+{
+	Instance inst{0.0, 0, vector<unsigned int>{}, vector<Node>{}};
+	unsigned int nodes = in.uint();
+	if (nodes < 2)
+		throw runtime_error("at least one node besides the deposit needed");
+	inst.threshold = in.real();
+
+	/* Ignore first node, for our representation, it is redundant */
+	inst.demand.reserve(nodes - 1);
+	in.uint();
+	for (unsigned int i = 1; i < nodes; i++)
+		inst.demand.push_back(in.uint());
+
+	inst.coords.reserve(nodes - 1);
+	in.real();
+	in.real();
+	for (unsigned int i = 1; i < nodes; i++) {
+		double x = in.real();
+		double y = in.real();
+		inst.coords.push_back(Node{x, y});
+	}
+	return inst;
+}
+
+/* Keyword format, much like CVRPLIB's */
+static Instance parse_keywords(Scanner &in)
+{
+	Instance inst{dl::infinity(), 0, vector<unsigned int>{}, vector<Node>{}};
+	unsigned int dimension = 0;
+	unsigned int depot = 1;
+	vector<Node> coords;
+	vector<unsigned int> demand;
+
+	while (in.more()) {
+		string key = in.word();
+		if (key == "EOF") {
+			break;
+		} else if (key == "DIMENSION") {
+			dimension = in.uint();
+			coords.assign(dimension, Node{});
+			demand.assign(dimension, 0);
+		} else if (key == "CAPACITY") {
+			inst.capacity = in.uint();
+		} else if (key == "RISK_THRESHOLD") {
+			inst.threshold = in.real();
+		} else if (key == "EDGE_WEIGHT_TYPE") {
+			if (in.word() != "EUC_2D")
+				throw runtime_error("only EUC_2D weights supported");
+		} else if (key == "NODE_COORD_SECTION") {
+			for (unsigned int i = 0; i < dimension; i++) {
+				unsigned int id = in.uint();
+				if (id < 1 || id > dimension)
+					throw runtime_error("node id out of range");
+				coords[id - 1].x = in.real();
+				coords[id - 1].y = in.real();
+			}
+		} else if (key == "DEMAND_SECTION") {
+			for (unsigned int i = 0; i < dimension; i++) {
+				unsigned int id = in.uint();
+				if (id < 1 || id > dimension)
+					throw runtime_error("node id out of range");
+				demand[id - 1] = in.uint();
+			}
+		} else if (key == "DEPOT_SECTION") {
+			/* A single deposit, list ends with -1 */
+			depot = in.uint();
+			while (in.more() && in.peek() != '-')
+				in.uint();
+			in.word();
+		} else {
+			/* NAME, TYPE, COMMENT or anything else unknown */
+			in.line();
+		}
+	}
+
+	if (dimension < 2)
+		throw runtime_error("at least one node besides the deposit needed");
+	if (depot < 1 || depot > dimension)
+		throw runtime_error("deposit out of range");
+
+	/* Move the deposit to the origin and drop it */
+	Node d = coords[depot - 1];
+	inst.coords.reserve(dimension - 1);
+	inst.demand.reserve(dimension - 1);
+	for (unsigned int i = 0; i < dimension; i++) {
+		if (i == depot - 1)
+			continue;
+		inst.coords.push_back(Node{coords[i].x - d.x, coords[i].y - d.y});
+		inst.demand.push_back(demand[i]);
+	}
+	return inst;
+}
+
+/* Parse an instance from memory, in any known format */
+Instance Loader::parse(char const *begin, char const *end)
+{
+	Instance inst{0.0, 0, vector<unsigned int>{}, vector<Node>{}};
+	if (!next(begin, end, inst))
+		throw runtime_error("empty instance");
+	return inst;
+}
+
+/* Parse the next of many concatenated instances, advancing p */
+bool Loader::next(char const *&p, char const *end, Instance &inst)
+{
+	Scanner in(p, end);
+	char c = in.peek();
+	if (c == '\0')
+		return false;
+	if (c >= '0' && c <= '9')
+		inst = parse_plain(in);
+	else
+		inst = parse_keywords(in);
+	p = in.at();
+	return true;
+}
+
+/* Read changes to an instance, one per line */
+vector<Change> Loader::delta(char const *path)
+{
+	ifstream in(path);
+	if (!in)
+		throw runtime_error(string("can not open ") + path);
+
+	vector<Change> delta;
+	string line;
+	while (getline(in, line)) {
+		istringstream words(line);
+		string op;
+		if (!(words >> op) || op[0] == '#')
+			continue;
+
+		Change c{Change::INSERT, 0, 0, Node()};
+		bool ok;
+		if (op == "insert") {
+			ok = (bool)(words >> c.demand >> c.at.x >> c.at.y);
+		} else if (op == "remove") {
+			c.kind = Change::REMOVE;
+			ok = (bool)(words >> c.node);
+		} else if (op == "update") {
+			c.kind = Change::UPDATE;
+			ok = (bool)(words >> c.node >> c.demand);
+		} else {
+			ok = false;
+		}
+		if (!ok)
+			throw runtime_error("bad change " + line);
+		delta.push_back(c);
+	}
+	return delta;
+}
+
+/* Read the whole standard input */
+vector<char> Loader::slurp(void)
+{
+	vector<char> buf;
+	char chunk[1 << 16];
+	size_t got;
+	while ((got = fread(chunk, 1, sizeof(chunk), stdin)) > 0)
+		buf.insert(buf.end(), chunk, chunk + got);
+	return buf;
+}
+
+/* Read a file (memory mapped), or stdin if path is null or "-" */
+Instance Loader::read(char const *path)
+{
+	/* Standard input can not be mapped, read it whole */
+	if (!path || !strcmp(path, "-")) {
+		vector<char> buf = slurp();
+		return parse(buf.data(), buf.data() + buf.size());
+	}
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		throw runtime_error(string("can not open ") + path);
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		throw runtime_error(string("can not stat ") + path);
+	}
+	size_t len = (size_t)st.st_size;
+	if (!len) {
+		close(fd);
+		return parse(nullptr, nullptr);
+	}
+
+	void *map = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		throw runtime_error(string("can not map ") + path);
+	madvise(map, len, MADV_SEQUENTIAL);
+
+	/* Unmap even if parsing fails */
+	char const *data = static_cast<char const *>(map);
+	try {
+		Instance inst = parse(data, data + len);
+		munmap(map, len);
+		return inst;
+	} catch (...) {
+		munmap(map, len);
+		throw;
+	}
+}
+
+/*
+ * Read the routes of a printed solution. Route lines end in the nodes, each
+ * after "->", and whatever comes before their last tab is ignored.
+ */
+Start Loader::start(char const *path)
+{
+	ifstream in(path);
+	if (!in)
+		throw runtime_error(string("can not open ") + path);
+
+	Start st{vector< vector<unsigned int> >{}, 0.0, 0.0};
+	string line;
+	while (getline(in, line)) {
+		/* Schedule state saved by checkpoints */
+		if (!line.compare(0, 14, "# temperature "))
+			st.temperature = stod(line.substr(14));
+		else if (!line.compare(0, 11, "# progress "))
+			st.progress = stod(line.substr(11));
+		if (line.find("->") == string::npos || line[0] == '#')
+			continue;
+
+		/* Nodes are printed from 1, the deposit being 0 */
+		vector<unsigned int> route;
+		size_t at = line.rfind('\t');
+		at = at == string::npos ? 0 : at + 1;
+		while (at < line.size()) {
+			char *end;
+			unsigned long node = strtoul(line.c_str() + at, &end, 10);
+			if (end == line.c_str() + at)
+				throw runtime_error("bad route " + line);
+			if (node)
+				route.push_back((unsigned int)(node - 1));
+			at = line.find("->", at);
+			at = at == string::npos ? line.size() : at + 2;
+		}
+		if (!route.empty())
+			st.routes.push_back(route);
+	}
+	return st;
+}
@@ -0,0 +1,176 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pool.h"
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+using std::function;
+using std::lock_guard;
+using std::max;
+using std::mutex;
+using std::thread;
+using std::unique_lock;
+using std::unique_ptr;
+using std::vector;
+
+/* Pool the calling thread works for, if any, and its id there */
+static thread_local Pool const *owner = nullptr;
+static thread_local unsigned int owned = 0;
+
+/* Start n workers (at least one) */
+Pool::Pool(unsigned int n)
+	: queues()
+	, workers()
+	, idle_m()
+	, idle_cv()
+	, pending(0)
+	, next(0)
+	, stop(false)
+{
+	n = max(n, 1u);
+	for (unsigned int i = 0; i < n; i++)
+		queues.push_back(unique_ptr<Queue>(new Queue()));
+	for (unsigned int i = 0; i < n; i++)
+		workers.push_back(thread(&Pool::work, this, i));
+}
+
+/* Finish pending tasks and stop every worker */
+Pool::~Pool()
+{
+	{
+		lock_guard<mutex> lock(idle_m);
+		stop = true;
+	}
+	idle_cv.notify_all();
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+/* Amount of workers */
+unsigned int Pool::size(void) const
+{
+	return (unsigned int)workers.size();
+}
+
+/*
+ * Bind each worker to its own processor, among those the process may use,
+ * so caches stay warm between tasks. Failing to do so is harmless.
+ */
+void Pool::pin(void)
+{
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed))
+		return;
+	vector<int> cpus;
+	for (int c = 0; c < CPU_SETSIZE; c++)
+		if (CPU_ISSET(c, &allowed))
+			cpus.push_back(c);
+	if (cpus.empty())
+		return;
+
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		cpu_set_t one;
+		CPU_ZERO(&one);
+		CPU_SET(cpus[i % cpus.size()], &one);
+		pthread_setaffinity_np(workers[i].native_handle(), sizeof(one),
+			&one);
+	}
+}
+
+/* Queue a task, spreading them among workers in turns */
+void Pool::push(function<void(void)> task)
+{
+	unsigned int id = next++ % (unsigned int)queues.size();
+
+	/* Counted first, so pending never falls behind queued tasks */
+	{
+		lock_guard<mutex> lock(idle_m);
+		pending++;
+	}
+	{
+		lock_guard<mutex> lock(queues[id]->m);
+		queues[id]->tasks.push_back(task);
+	}
+	idle_cv.notify_one();
+}
+
+/* Take a task from our own queue, or steal one from another */
+bool Pool::pop(unsigned int id, function<void(void)> &task)
+{
+	unsigned int n = (unsigned int)queues.size();
+	for (unsigned int i = 0; i < n; i++) {
+		Queue &q = *queues[(id + i) % n];
+		lock_guard<mutex> lock(q.m);
+		if (q.tasks.empty())
+			continue;
+		if (i == 0) {
+			task = q.tasks.front();
+			q.tasks.pop_front();
+		} else {
+			task = q.tasks.back();
+			q.tasks.pop_back();
+		}
+		pending--;
+		return true;
+	}
+	return false;
+}
+
+/* Whether the calling thread is a worker of this pool */
+bool Pool::inside(void) const
+{
+	return owner == this;
+}
+
+/* Run a queued task on the calling worker, false if none is left */
+bool Pool::help(void)
+{
+	function<void(void)> task;
+	if (!inside() || !pop(owned, task))
+		return false;
+	task();
+	return true;
+}
+
+/* Worker loop */
+void Pool::work(unsigned int id)
+{
+	function<void(void)> task;
+	owner = this;
+	owned = id;
+	for (;;) {
+		if (pop(id, task)) {
+			task();
+			continue;
+		}
+
+		/* Nothing to do, sleep until something is queued */
+		unique_lock<mutex> lock(idle_m);
+		while (!stop && !pending)
+			idle_cv.wait(lock);
+		if (stop && !pending)
+			return;
+	}
+}
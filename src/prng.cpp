@@ -0,0 +1,46 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "prng.h"
+#include <cstdint>
+
+using std::uint64_t;
+
+/* Step of splitmix64, used to spread seeds over the whole state */
+static uint64_t splitmix(uint64_t &x)
+{
+	uint64_t z = (x += UINT64_C(0x9e3779b97f4a7c15));
+	z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+	z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+	return z ^ (z >> 31);
+}
+
+/* Seed the generator */
+Prng::Prng(uint64_t seed)
+	: s()
+{
+	for (unsigned int i = 0; i < 4; i++)
+		s[i] = splitmix(seed);
+}
+
+/* Seed of the i-th worker derived from a base seed */
+uint64_t Prng::derive(uint64_t seed, uint64_t i)
+{
+	uint64_t x = seed ^ (i * UINT64_C(0xd1b54a32d192ed03));
+	return splitmix(x);
+}
@@ -15,82 +15,140 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include "batch.h"
 #include "config.h"
+#include "context.h"
+#include "loader.h"
 #include "node.h"
+#include "pool.h"
 #include "rcvrp.h"
-#include "sa.h"
+#include "server.h"
 #include "solution.h"
-#include <future>
+#include "solver.h"
+#include "telemetry.h"
+#include <cstring>
+#include <exception>
 #include <iostream>
 #include <vector>
+#include <signal.h>
 
-using std::async;
-using std::cin;
-using std::cout;
-using std::fixed;
-using std::future;
+using std::cerr;
+using std::exception;
+using std::memset;
 using std::vector;
 
-int main(int const argc, char const **argv)
-{
-	/* Parse arguments */
-	parse_cfg(argc, argv);
+/* Context being solved, which signals stop */
+static Context *running = nullptr;
 
-	/* Read instance from stdin */
-	unsigned int nodes;
-	cin >> nodes;
+/* Signal handler, which only raises the flag of the running context */
+static void on_signal(int)
+{
+	if (running)
+		running->stop();
+}
 
-	/* Read risk threshold from stdin */
-	double threshold;
-	cin >> threshold;
-	ctx.risk_threshold = threshold;
+/* Stop workers on SIGINT or SIGUSR1, a second SIGINT kills as usual */
+static void catch_signals(void)
+{
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGUSR1, &sa, nullptr);
+	sa.sa_flags = SA_RESETHAND;
+	sigaction(SIGINT, &sa, nullptr);
+}
 
-	/* Prepare the initial solution */
-	Solution sol(nodes - 1);
+int main(int const argc, char const **argv)
+{
+	/* Parse arguments */
+	struct rcvrp_cfg cfg;
+	try {
+		parse_cfg(cfg, argc, argv);
+	} catch (exception const &e) {
+		cerr << "rcvrp: " << e.what() << '\n';
+		return 1;
+	}
 
-	/* Store demands in initial solution */
-	for (unsigned int i = 0; i < nodes; i++) {
-		unsigned int d;
-		cin >> d;
+	/* Workers live for the whole run, and so does the context */
+	Context ctx(cfg);
+	Pool pool(cfg.threads);
 
-		/* Ignore first node, for our representation, it is redundant */
-		if (i == 0)
-			continue;
-		Solution::demand.push_back(d);
+	/* Maybe serve requests, solving instances as they come */
+	if (cfg.serve) {
+		try {
+			return serve(cfg, cfg.serve, pool);
+		} catch (exception const &e) {
+			cerr << "rcvrp: " << e.what() << '\n';
+			return 1;
+		}
 	}
 
-	for (unsigned int i = 0; i < nodes; i++) {
-		double x;
-		double y;
-
-		cin >> x;
-		cin >> y;
+	/* Maybe solve many instances */
+	if (cfg.batch) {
+		int status;
+		try {
+			status = batch(ctx, cfg.batch, cfg.output, pool);
+		} catch (exception const &e) {
+			cerr << "rcvrp: " << e.what() << '\n';
+			return 1;
+		}
+		Telemetry::report(ctx);
+		return status;
+	}
 
-		/* Ignore first node, for our representation, it is redundant */
-		if (i == 0)
-			continue;
-		Solution::coords.push_back(Node{x, y});
+	/*
+	 * Read instance from a file or stdin, maybe a solution to start from and
+	 * changes to make to them
+	 */
+	Instance inst{0.0, 0, vector<unsigned int>{}, vector<Node>{}};
+	Start start{vector< vector<unsigned int> >{}, 0.0, 0.0};
+	vector<Change> delta;
+	try {
+		inst = Loader::read(cfg.input);
+		if (cfg.start)
+			start = Loader::start(cfg.start);
+		if (cfg.delta)
+			delta = Loader::delta(cfg.delta);
+	} catch (exception const &e) {
+		cerr << "rcvrp: " << e.what() << '\n';
+		return 1;
 	}
 
-	/* Start solving using many threads */
-	vector< future<Solution> > threads(ctx.threads);
-	for (unsigned int i = 0; i < ctx.threads; i++)
-		threads.at(i) = async(sa, sol, threshold);
+	/* Solve it, going on from where a checkpoint was */
+	Solution sol = Solver::prepare(ctx, inst, cfg.v_cap, pool);
+	double threshold = ctx.cfg.risk_threshold;
+	if (cfg.start) {
+		Solver::warm(sol, start, threshold);
+		ctx.cfg.resume_temperature = start.temperature;
+		ctx.cfg.resume_progress = start.progress;
+	}
 
-	/* Wait for each thread to finish */
-	vector<Solution> results(ctx.threads);
-	for (unsigned int i = 0; i < ctx.threads; i++)
-		results.at(i) = threads.at(i).get();
+	/* Changed instances only solve again what changed */
+	vector<unsigned int> touched;
+	if (cfg.delta) {
+		try {
+			touched = Solver::change(ctx, sol, delta);
+		} catch (exception const &e) {
+			cerr << "rcvrp: " << e.what() << '\n';
+			return 1;
+		}
+	}
 
-	/* Select best solution among thread executions */
-	Solution best = results.at(0);
-	for (unsigned int i = 0; i < results.size(); i++)
-		if (results.at(i).eval(threshold) < best.eval(threshold))
-			best = results.at(i);
+	/* Signals stop workers early, the best solution so far is printed */
+	running = &ctx;
+	catch_signals();
+	Solution best = cfg.delta ?
+		Solver::replan(ctx, sol, touched, threshold, Solver::seed(cfg),
+			pool) :
+		Solver::solve(ctx, sol, threshold, Solver::seed(cfg), pool);
 
 	/* Output best solution cost and nodes */
 	best.print(threshold);
 
+	/* And how workers got there, if asked to */
+	Telemetry::report(ctx);
+
 	/* At this point, everything is fine */
 	return 0;
 }
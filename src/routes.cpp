@@ -0,0 +1,437 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "routes.h"
+#include "config.h"
+#include "context.h"
+#include "solution.h"
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+using dl = std::numeric_limits<double>;
+using std::copy;
+using std::min;
+using std::size_t;
+using std::sort;
+using std::vector;
+
+/* Stops the arena holds per node: every route, and one grown with its room */
+static unsigned int const ARENA = 3;
+
+/* Empty set of routes */
+Routes::Routes(void)
+	: stops()
+	, slots()
+	, spare()
+	, of()
+	, at()
+	, order()
+	, end(0)
+	, thr(0.0)
+	, ctx(nullptr)
+{}
+
+/*
+ * Copy of some routes, with room for as many routes as nodes, so assigning
+ * other routes of the same instance to it does not allocate
+ */
+Routes::Routes(Routes const &other)
+	: stops(other.stops)
+	, slots()
+	, spare()
+	, of(other.of)
+	, at(other.at)
+	, order()
+	, end(other.end)
+	, thr(other.thr)
+	, ctx(other.ctx)
+{
+	slots.reserve(of.size());
+	spare.reserve(of.size());
+	order.reserve(of.size());
+	slots = other.slots;
+	spare = other.spare;
+}
+
+/* Routes of a solution */
+Routes::Routes(Solution const &sol, double threshold)
+	: Routes()
+{
+	read(sol, threshold);
+}
+
+/* Recompute prefix sums of route r from its nodes */
+void Routes::fill(unsigned int r)
+{
+	Stop *s = stops.data() + slots[r].first;
+	for (unsigned int t = 0; t < slots[r].size; t++) {
+		unsigned int c = s[t].node;
+		of[c] = r;
+		at[c] = t;
+
+		/* Coming from the deposit, with the first money counted already */
+		if (t == 0) {
+			s[t] = Stop{c, (double)ctx->demand[c],
+				ctx->distance.depot(c), 0.0, 0.0};
+			continue;
+		}
+
+		/* Leaving the previous node, picking up its money */
+		Stop const &p = s[t - 1];
+		double dist = ctx->distance(p.node, c);
+		double carry = p.carry + ctx->demand[p.node];
+		s[t] = Stop{c, carry, p.length + dist, p.risk + p.carry * dist,
+			p.carried + carry};
+	}
+}
+
+/* Read routes from the permutation, starting right after a route end */
+void Routes::read(Solution const &sol, double threshold)
+{
+	unsigned int n = (unsigned int)sol.perm.size();
+
+	thr = threshold;
+	ctx = sol.ctx;
+	of.assign(n, 0);
+	at.assign(n, 0);
+
+	/* Everything is sized here once, there are never more routes than nodes */
+	stops.resize((size_t)ARENA * n);
+	slots.clear();
+	slots.reserve(n);
+	spare.clear();
+	spare.reserve(n);
+	order.reserve(n);
+
+	/* Routes packed one after the other, with no room to spare */
+	end = 0;
+	unsigned int st = 0;
+	while (!sol.orig[sol.perm[st++]]);
+	for (unsigned int i = 0; i < n; i++) {
+		unsigned int c = sol.perm[(st + i) % n];
+		if (sol.orig[sol.perm[(st + i + n - 1) % n]])
+			slots.push_back(Slot{end, 0, 0});
+		stops[end++] = Stop{c, 0.0, 0.0, 0.0, 0.0};
+		slots.back().size++;
+		slots.back().room++;
+	}
+	for (unsigned int r = 0; r < slots.size(); r++)
+		fill(r);
+}
+
+/*
+ * Write routes as a permutation and route end flags. Solutions are read from
+ * right after their first route end, so the last route goes first and the
+ * order of routes is kept.
+ */
+void Routes::write(Solution &sol) const
+{
+	unsigned int last = (unsigned int)slots.size();
+	while (last > 0 && !slots[last - 1].size)
+		last--;
+
+	sol.perm.clear();
+	sol.orig.assign(of.size(), false);
+	for (unsigned int i = 0; i < last; i++) {
+		unsigned int r = (i + last - 1) % last;
+		for (unsigned int t = 0; t < slots[r].size; t++)
+			sol.perm.push_back(stop(r, t).node);
+		if (slots[r].size)
+			sol.orig[stop(r, slots[r].size - 1).node] = true;
+	}
+}
+
+/* Amount of routes in use */
+unsigned int Routes::count(void) const
+{
+	return (unsigned int)(slots.size() - spare.size());
+}
+
+/* Amount of route ids, used or not */
+unsigned int Routes::ids(void) const
+{
+	return (unsigned int)slots.size();
+}
+
+/* Whether a route id is in use */
+bool Routes::used(unsigned int r) const
+{
+	return slots[r].size > 0;
+}
+
+/* Route of a node */
+unsigned int Routes::route_of(unsigned int node) const
+{
+	return of[node];
+}
+
+/* Position of a node within its route */
+unsigned int Routes::position(unsigned int node) const
+{
+	return at[node];
+}
+
+/* Amount of stops of a route */
+unsigned int Routes::length(unsigned int r) const
+{
+	return slots[r].size;
+}
+
+/* Stop i of route r */
+Stop const &Routes::stop(unsigned int r, unsigned int i) const
+{
+	return stops[slots[r].first + i];
+}
+
+/* Risk of a route once back at the deposit */
+double Routes::risk(unsigned int r) const
+{
+	Stop const &s = stop(r, slots[r].size - 1);
+	return s.risk + s.carry * ctx->distance.depot(s.node);
+}
+
+/* Most money carried along a route, which is checked against capacity */
+double Routes::load(unsigned int r) const
+{
+	return stop(r, slots[r].size - 1).carry;
+}
+
+/* Distance traveled by a route */
+double Routes::distance(unsigned int r) const
+{
+	Stop const &s = stop(r, slots[r].size - 1);
+	return s.length + ctx->distance.depot(s.node);
+}
+
+/* Whether a route is within risk threshold and capacity */
+bool Routes::feasible(unsigned int r) const
+{
+	unsigned int cap = ctx->cfg.v_cap;
+	return !(risk(r) > thr) && !(cap && load(r) > cap);
+}
+
+/* Cost of a route, including punishments */
+double Routes::cost(unsigned int r) const
+{
+	Label l = open();
+	append(l, r, 0, length(r));
+	return close(l);
+}
+
+/* Nothing visited yet */
+Label Routes::open(void) const
+{
+	return Label{0, 0.0, 0.0, 0.0, 0.0, true};
+}
+
+/*
+ * Append stops [i, j) of route r. Every step of the piece carries the same
+ * offset of money relative to the original route, so its risk is shifted by
+ * the offset times its length.
+ */
+void Routes::append(Label &l, unsigned int r, unsigned int i, unsigned int j)
+	const
+{
+	Stop const *s = stops.data() + slots[r].first;
+	unsigned int first = s[i].node;
+
+	if (l.empty) {
+		/* Coming from the deposit */
+		l = Label{first, (double)ctx->demand[first],
+			ctx->distance.depot(first), 0.0, 0.0, false};
+	} else {
+		/* Step from the last node, just like a full evaluation */
+		double dist = ctx->distance(l.last, first);
+		l.risk += l.carry * dist;
+		l.carry += ctx->demand[l.last];
+		l.length += dist;
+		if (l.risk > thr)
+			l.paid += l.carry;
+		l.last = first;
+	}
+
+	if (j - i < 2)
+		return;
+
+	/* Risk on arrival at stop t is base + s[t].risk + off * s[t].length */
+	double off = l.carry - s[i].carry;
+	double base = l.risk - s[i].risk - off * s[i].length;
+	double risk = base + s[j - 1].risk + off * s[j - 1].length;
+
+	/* Punish steps from the first one arriving over the threshold */
+	if (risk > thr) {
+		unsigned int lo = i + 1;
+		unsigned int hi = j - 1;
+		while (lo < hi) {
+			unsigned int mid = lo + (hi - lo) / 2;
+			if (base + s[mid].risk + off * s[mid].length > thr)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		l.paid += s[j - 1].carried - s[lo - 1].carried + off * (j - lo);
+	}
+
+	l.last = s[j - 1].node;
+	l.carry = s[j - 1].carry + off;
+	l.length += s[j - 1].length - s[i].length;
+	l.risk = risk;
+}
+
+/* Append a single node */
+void Routes::append(Label &l, unsigned int node) const
+{
+	append(l, of[node], at[node], at[node] + 1);
+}
+
+/*
+ * Go back to the deposit and return the route cost, infinite if over
+ * capacity. Maybe tell whether it ends over the risk threshold too.
+ */
+double Routes::close(Label l, bool *risky) const
+{
+	if (l.empty) {
+		if (risky)
+			*risky = false;
+		return 0.0;
+	}
+
+	double dist = ctx->distance.depot(l.last);
+	l.risk += l.carry * dist;
+	l.length += dist;
+	if (l.risk > thr)
+		l.paid += l.carry;
+
+	if (risky)
+		*risky = l.risk > thr;
+	if (ctx->cfg.v_cap && l.carry > ctx->cfg.v_cap)
+		return dl::infinity();
+	return l.length + l.paid * ctx->avg_dist;
+}
+
+/* Release or take again route r, about to hold n nodes */
+void Routes::mark(unsigned int r, unsigned int n)
+{
+	if (!n && slots[r].size) {
+		spare.push_back(r);
+	} else if (n && !slots[r].size) {
+		/* Taken again, most likely the last one released */
+		unsigned int s = (unsigned int)spare.size();
+		while (s > 0 && spare[s - 1] != r)
+			s--;
+		if (s > 0)
+			spare.erase(spare.begin() + (s - 1));
+	}
+}
+
+/*
+ * Make room for n stops of route r, whose stops are no longer needed. Not
+ * fitting, it moves to the end of the arena with room to double.
+ */
+void Routes::fit(unsigned int r, unsigned int n)
+{
+	if (n <= slots[r].room)
+		return;
+	slots[r].room = 0;
+	if (end + 2 * n > stops.size())
+		pack();
+	slots[r].first = end;
+	slots[r].room = min(2 * n, (unsigned int)stops.size() - end);
+	end += slots[r].room;
+}
+
+/* Slide routes to the start of the arena, in order, leaving no room */
+void Routes::pack(void)
+{
+	order.clear();
+	for (unsigned int r = 0; r < slots.size(); r++) {
+		if (slots[r].size)
+			order.push_back(r);
+		else
+			slots[r].room = 0;
+	}
+	sort(order.begin(), order.end(), [this](unsigned int a,
+			unsigned int b) {
+		return slots[a].first < slots[b].first;
+	});
+
+	/* Moving routes back never overwrites one not moved yet */
+	end = 0;
+	for (unsigned int i = 0; i < order.size(); i++) {
+		Slot &slot = slots[order[i]];
+		copy(stops.begin() + slot.first,
+			stops.begin() + slot.first + slot.size,
+			stops.begin() + end);
+		slot.first = end;
+		slot.room = slot.size;
+		end += slot.size;
+	}
+}
+
+/* Write the n nodes of route r and sum them up */
+void Routes::place(unsigned int r, unsigned int const *nodes, unsigned int n)
+{
+	slots[r].size = 0;
+	fit(r, n);
+	slots[r].size = n;
+	Stop *s = stops.data() + slots[r].first;
+	for (unsigned int t = 0; t < n; t++)
+		s[t].node = nodes[t];
+	fill(r);
+}
+
+/* Replace the n nodes of a route, an empty one is released */
+void Routes::assign(unsigned int r, unsigned int const *nodes, unsigned int n)
+{
+	mark(r, n);
+	place(r, nodes, n);
+}
+
+/* Replace the nodes of two routes, the longer one taking the bigger room */
+void Routes::assign(unsigned int r, unsigned int const *nodes, unsigned int n,
+	unsigned int s, unsigned int const *others, unsigned int m)
+{
+	mark(r, n);
+	mark(s, m);
+	slots[r].size = 0;
+	slots[s].size = 0;
+	if ((n > m && slots[r].room < slots[s].room) ||
+			(m > n && slots[s].room < slots[r].room)) {
+		Slot swapped = slots[r];
+		slots[r] = slots[s];
+		slots[s] = swapped;
+	}
+	place(r, nodes, n);
+	place(s, others, m);
+}
+
+/* New route with some nodes, reusing a released id if possible */
+unsigned int Routes::add(unsigned int const *nodes, unsigned int n)
+{
+	unsigned int r;
+	if (spare.empty()) {
+		r = (unsigned int)slots.size();
+		slots.push_back(Slot{end, 0, 0});
+	} else {
+		r = spare.back();
+	}
+	assign(r, nodes, n);
+	return r;
+}
@@ -17,66 +17,118 @@
  */
 
 #include "sa.h"
+#include "anytime.h"
+#include "chain.h"
 #include "temperature.h"
+#include "checkpoint.h"
 #include "config.h"
+#include "context.h"
+#include "exchange.h"
+#include "telemetry.h"
 #include "timer.h"
 #include <chrono>
-#include <cmath>
-#include <random>
+#include <cstdint>
+#include <memory>
 
-using std::exp;
-using std::fabs;
-using std::random_device;
-using unif_dbl_d = std::uniform_real_distribution<double>;
+using std::shared_ptr;
+using std::uint64_t;
 
-#if BENCHMARK
-#include <iostream>
-using std::fixed;
-using std::cerr;
-#endif
+/* Iterations between updates of the temperature schedule */
+static unsigned long const ADAPT_EVERY = 1024;
 
-Solution sa(Solution sol, double risk)
-{
-	/* Initial greedy solution */
-	sol.greedy_init();
+/* Milliseconds between reports of new best solutions by one worker */
+static double const STREAM_MS = 5.0;
 
-	/* Prepare variables for neighbors, PRNGs and thermometer */
-	Solution best{sol};
-	Solution neigh{sol};
-	Temperature t(ctx.temperature);
+Solution sa(Context const &ctx, Solution sol, double risk, uint64_t seed,
+	Exchange *shared, Checkpoint *saving, Anytime *stream)
+{
+	struct rcvrp_cfg const &cfg = ctx.cfg;
 
-	random_device rd;
-	unif_dbl_d rd_double(0.0, 1.0);
+	/* Start from the shared greedy solution */
+	sol.track(risk);
 
-	/* Iterate through neighbors in a time window */
+	/* Prepare the chain of neighbors, its PRNG and thermometer */
 	Timer timer;
+	Telemetry *tm = Telemetry::enroll(ctx,
+		shared ? "island" : "independent");
+	Chain chain(sol, seed, tm);
+	if (tm)
+		tm->seed = seed;
+	Temperature t = cfg.schedule == SCHEDULE_AUTO ?
+		Temperature(chain.curr, chain.rng, cfg) :
+		Temperature(cfg.resume_temperature > 0.0 ?
+			cfg.resume_temperature : cfg.temperature, cfg);
+
+	/* Island model, checkpoint and trace bookkeeping */
+	unsigned long it = 0;
+	double synced_cost = chain.best_cost;
+	double offered = 0.0;
+	double seen = chain.best_cost;
+	double streamed = -STREAM_MS;
 
-/* Maybe we want to see the value of each neightbor */
-#if BENCHMARK
-		cerr.precision(6);
-#endif
+	/* Iterate through neighbors for some iterations, or a time window */
 	do {
-#if BENCHMARK
-			cerr << fixed << neigh.eval(risk) << '\n';
-#endif
-		/* Copy current solution and generate a neighbor from it */
-		Solution nneigh{neigh};
-		nneigh.any_neighbor();
+		/* Move to a neighbor, maybe, out of a few candidates */
+		unsigned long last = it;
+		it += chain.steps(t, cfg.candidates);
+
+		/* Report a new best solution right away, rate limited per worker */
+		if (stream && chain.best_cost < seen) {
+			seen = chain.best_cost;
+			if (seen < stream->cost()) {
+				double ms = timer.elapsed();
+				if (ms >= streamed + STREAM_MS) {
+					stream->offer(seen, chain.best_fleet());
+					streamed = ms;
+				}
+			}
+		}
+
+		/*
+		 * Follow the schedule along the budget, going on from where a
+		 * resumed run was. Maybe offer the best solution to be saved,
+		 * and report one held back by the rate limit.
+		 */
+		if (it / ADAPT_EVERY != last / ADAPT_EVERY) {
+			double ms = timer.elapsed();
+			double progress = cfg.resume_progress
+				+ (1.0 - cfg.resume_progress) * (cfg.budget ?
+				(double)it / (double)cfg.budget : ms / cfg.max_ms);
+			t.adapt(progress, it, chain.accepted, chain.best_cost);
+			if (saving && ms >= offered + cfg.checkpoint_ms) {
+				saving->offer(chain.snapshot(), chain.best_cost,
+					t.value(), progress);
+				offered = ms;
+			}
+			if (stream && chain.best_cost < stream->cost())
+				stream->offer(chain.best_cost, chain.best_fleet());
+		}
 
-		/* Evaluate them and get the difference */
-		double diff = neigh.eval(risk) - nneigh.eval(risk);
+		/* Sample the trace every few iterations */
+		if (tm && it / cfg.trace_every != last / cfg.trace_every)
+			tm->sample(it, t.value(), chain.curr.cost());
 
-		/* If neighbor is better, switch to it */
-		if (diff > 0.0f)
-			neigh = nneigh;
-		/* Or maybe just switch to it randomly */
-		else if (rd_double(rd) < exp(diff / t()))
-			neigh = nneigh;
-		/* And check if the new one is the best one so far */
-		if (neigh.eval(risk) < best.eval(risk))
-			best = neigh;
-	/* Until time is up */
-	} while (timer.loop_incomplete(ctx.max_ms));
+		/* Cooperate with other workers every few iterations */
+		if (shared && it / cfg.migration != last / cfg.migration) {
+			if (chain.best_cost < shared->cost()) {
+				/* Leading, let others know */
+				shared->publish(chain.snapshot(), chain.best_cost);
+			} else if (shared->cost() < chain.best_cost
+				&& !(chain.best_cost < synced_cost)) {
+				/* Lagging and stuck, migrate to the global best */
+				shared_ptr<Snapshot const> g = shared->fetch();
+				if (g)
+					chain.restart(g->sol, g->cost);
+			}
+			synced_cost = chain.best_cost;
+		}
+	/* Until the budget is spent, or told to stop */
+	} while (!ctx.stopped()
+		&& (cfg.budget ? it < cfg.budget : timer.running(cfg.max_ms)));
 
-	return best;
+	if (stream)
+		stream->offer(chain.best_cost, chain.best_fleet());
+	if (tm)
+		tm->finish(chain.best_cost);
+	return chain.snapshot();
 }
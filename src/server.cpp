@@ -0,0 +1,376 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "server.h"
+#include "config.h"
+#include "context.h"
+#include "json.h"
+#include "loader.h"
+#include "node.h"
+#include "pool.h"
+#include "routes.h"
+#include "solution.h"
+#include "solver.h"
+#include "telemetry.h"
+#include "timer.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using std::condition_variable;
+using std::exception;
+using std::fixed;
+using std::invalid_argument;
+using std::max;
+using std::list;
+using std::lock_guard;
+using std::memset;
+using std::move;
+using std::mutex;
+using std::ostringstream;
+using std::runtime_error;
+using std::string;
+using std::strerror;
+using std::strlen;
+using std::strncpy;
+using std::thread;
+using std::unique_lock;
+using std::unique_ptr;
+using std::vector;
+
+/* Bytes read from a connection at once */
+static size_t const CHUNK = 1 << 16;
+
+/* Requests being solved for a connection, and its answers */
+struct Session {
+	int out;
+	mutex lock;
+	condition_variable idle;
+	unsigned int open;
+
+	Session(int _out)
+		: out(_out)
+		, lock()
+		, idle()
+		, open(0)
+	{}
+};
+
+/*
+ * Requests are solved as tasks on the pool, a few at once over every session.
+ * Contexts of finished requests are kept, so later ones reuse their buffers
+ * instead of allocating distances and candidate lists again.
+ */
+class Server {
+private:
+	struct rcvrp_cfg const &cfg;
+	Pool &pool;
+	mutex spare_lock;
+	vector< unique_ptr<Context> > spare;
+
+	/* Requests being solved, readers wait while there are limit of them */
+	mutex busy_lock;
+	condition_variable room;
+	unsigned int busy;
+	unsigned int limit;
+
+	unique_ptr<Context> take(struct rcvrp_cfg const &with);
+	void give(unique_ptr<Context> ctx);
+	string answer(string const &line);
+	void request(Session *session, string line);
+public:
+	Server(struct rcvrp_cfg const &_cfg, Pool &_pool)
+		: cfg(_cfg)
+		, pool(_pool)
+		, spare_lock()
+		, spare()
+		, busy_lock()
+		, room()
+		, busy(0)
+		, limit(max(_pool.size(), 2u))
+	{}
+	Server(Server const &) = delete;
+	Server &operator=(Server const &) = delete;
+
+	/* Answer every request read from in, return once they are all done */
+	void session(int in, int out);
+};
+
+/* A kept context set up with a configuration, or a new one */
+unique_ptr<Context> Server::take(struct rcvrp_cfg const &with)
+{
+	unique_ptr<Context> ctx;
+	{
+		lock_guard<mutex> guard(spare_lock);
+		if (!spare.empty()) {
+			ctx.swap(spare.back());
+			spare.pop_back();
+		}
+	}
+	if (!ctx)
+		return unique_ptr<Context>(new Context(with));
+
+	ctx->cfg = with;
+	ctx->resume();
+	ctx->enrolled.clear();
+	return ctx;
+}
+
+/* Keep a context for later requests */
+void Server::give(unique_ptr<Context> ctx)
+{
+	lock_guard<mutex> guard(spare_lock);
+	spare.push_back(unique_ptr<Context>());
+	spare.back().swap(ctx);
+}
+
+/*
+ * Solve a request: an object with an "instance" as text or the "path" of a
+ * file, and maybe variables in "cfg" and an "id" copied to the answer
+ */
+string Server::answer(string const &line)
+{
+	Timer timer;
+	string id = "null";
+	try {
+		Json req = Json::parse(line.data(), line.data() + line.size());
+		if (req.kind != Json::OBJECT)
+			throw invalid_argument("request is not an object");
+		Json const *v = req.get("id");
+		if (v)
+			id = v->kind == Json::STRING ? Json::quote(v->text) : v->text;
+
+		/* Variables override the server ones for this request only */
+		struct rcvrp_cfg with = cfg;
+		list<string> values;
+		Json const *vars = req.get("cfg");
+		if (vars && vars->kind != Json::OBJECT)
+			throw invalid_argument("cfg is not an object");
+		for (unsigned int i = 0; vars && i < vars->keys.size(); i++) {
+			Json const &var = vars->items[i];
+			if (var.kind != Json::STRING && var.kind != Json::NUMBER)
+				throw invalid_argument("bad value of " + vars->keys[i]);
+
+			/* Clients do not get to write files on the server */
+			if (vars->keys[i] == "TELEMETRY" ||
+					vars->keys[i] == "ANYTIME")
+				throw invalid_argument(vars->keys[i] +
+					" can not be set by requests");
+			values.push_back(var.text);
+			set_cfg(with, vars->keys[i], values.back().c_str());
+		}
+
+		Instance inst{0.0, 0, vector<unsigned int>{}, vector<Node>{}};
+		Json const *text = req.get("instance");
+		Json const *path = req.get("path");
+		if (text && text->kind == Json::STRING)
+			inst = Loader::parse(text->text.data(),
+				text->text.data() + text->text.size());
+		else if (path && path->kind == Json::STRING)
+			inst = Loader::read(path->text.c_str());
+		else
+			throw invalid_argument("neither instance nor path given");
+
+		/* Solve it on the shared pool */
+		unique_ptr<Context> ctx = take(with);
+		Solution sol = Solver::prepare(*ctx, inst, with.v_cap, pool);
+		double threshold = ctx->cfg.risk_threshold;
+		Solution best = Solver::solve(*ctx, sol, threshold,
+			Solver::seed(with), pool);
+
+		/* Answer with the cost and the routes, numbered as printed */
+		ostringstream out;
+		Routes routes(best, threshold);
+		out.precision(6);
+		out << fixed << "{\"id\":" << id
+			<< ",\"cost\":" << best.eval(threshold)
+			<< ",\"vehicles\":" << routes.count()
+			<< ",\"ms\":" << timer.elapsed()
+			<< ",\"routes\":[";
+		bool first = true;
+		for (unsigned int r = 0; r < routes.ids(); r++) {
+			if (!routes.used(r))
+				continue;
+			out << (first ? "[" : ",[");
+			first = false;
+			for (unsigned int i = 0; i < routes.length(r); i++)
+				out << (i ? "," : "") << routes.stop(r, i).node + 1;
+			out << ']';
+		}
+		out << "]}\n";
+		give(move(ctx));
+		return out.str();
+	} catch (exception const &e) {
+		return "{\"id\":" + id + ",\"error\":" + Json::quote(e.what()) +
+			"}\n";
+	}
+}
+
+/* Write a whole answer, dropping it if the client is gone */
+static void send(int fd, string const &s)
+{
+	size_t done = 0;
+	while (done < s.size()) {
+		ssize_t w = write(fd, s.data() + done, s.size() - done);
+		if (w < 0 && errno == EINTR)
+			continue;
+		if (w <= 0)
+			return;
+		done += (size_t)w;
+	}
+}
+
+/* Answer a request, as a task on the pool */
+void Server::request(Session *session, string line)
+{
+	string reply = answer(line);
+	{
+		lock_guard<mutex> guard(busy_lock);
+		busy--;
+		room.notify_one();
+	}
+
+	lock_guard<mutex> guard(session->lock);
+	send(session->out, reply);
+	if (!--session->open)
+		session->idle.notify_all();
+}
+
+/* Answer every request read from in, return once they are all done */
+void Server::session(int in, int out)
+{
+	Session session(out);
+	vector<char> buffer;
+	size_t start = 0;
+
+	for (;;) {
+		/* Every complete line is a request, blank ones are skipped */
+		size_t end = start;
+		while (end < buffer.size() && buffer[end] != '\n')
+			end++;
+		if (end < buffer.size()) {
+			string line(buffer.data() + start, end - start);
+			start = end + 1;
+			if (line.find_first_not_of(" \t\r") == string::npos)
+				continue;
+			{
+				unique_lock<mutex> lock(busy_lock);
+				while (busy >= limit)
+					room.wait(lock);
+				busy++;
+			}
+			{
+				lock_guard<mutex> guard(session.lock);
+				session.open++;
+			}
+			Session *at = &session;
+			pool.submit([this, at, line]() {
+				request(at, line);
+			});
+			continue;
+		}
+
+		/* Keep the partial line, read more */
+		buffer.erase(buffer.begin(), buffer.begin() + (long)start);
+		start = 0;
+		size_t had = buffer.size();
+		buffer.resize(had + CHUNK);
+		ssize_t r = read(in, buffer.data() + had, CHUNK);
+		if (r < 0 && errno == EINTR)
+			r = 0;
+		else if (r <= 0)
+			break;
+		buffer.resize(had + (size_t)r);
+	}
+
+	/* Requests still being solved write to this session */
+	unique_lock<mutex> lock(session.lock);
+	while (session.open)
+		session.idle.wait(lock);
+}
+
+/* Listen on a Unix socket at path, replacing a stale one */
+static int listen_at(char const *path)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path))
+		throw invalid_argument(string("socket path too long ") + path);
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	struct stat st;
+	if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+			listen(fd, SOMAXCONN)) {
+		string why = strerror(errno);
+		if (fd >= 0)
+			close(fd);
+		throw runtime_error(string("can not listen on ") + path + ": " +
+			why);
+	}
+	return fd;
+}
+
+/* Serve requests on stdin and stdout, or on a Unix socket */
+int serve(struct rcvrp_cfg const &cfg, char const *path, Pool &pool)
+{
+	/* Clients leaving early must not kill the server */
+	signal(SIGPIPE, SIG_IGN);
+	pool.pin();
+
+	Server server(cfg, pool);
+	if (string(path) == "-") {
+		server.session(STDIN_FILENO, STDOUT_FILENO);
+		return 0;
+	}
+
+	/* Each connection is read on a thread of its own */
+	int fd = listen_at(path);
+	for (;;) {
+		int client = accept(fd, nullptr, nullptr);
+		if (client < 0 && errno == EINTR)
+			continue;
+		if (client < 0)
+			throw runtime_error(string("can not accept: ") +
+				strerror(errno));
+		thread([&server, client]() {
+			server.session(client, client);
+			close(client);
+		}).detach();
+	}
+}
@@ -17,52 +17,179 @@
  */
 
 #include "solution.h"
+#include "context.h"
+#include "evaluator.h"
 #include "heuristic.h"
 #include "config.h"
+#include "routes.h"
 #include <algorithm>
+#include <climits>
 #include <cmath>
+#include <cstddef>
 #include <iostream>
 #include <limits>
-#include <queue>
-#include <random>
+#include <utility>
 #include <vector>
 
 using dl = std::numeric_limits<double>;
-using std::all_of;
+using std::min;
+using std::size_t;
+using std::rotate;
 using std::cout;
 using std::fabs;
+using std::isinf;
 using std::fixed;
-using std::queue;
-using std::random_device;
+using std::make_pair;
+using std::ostream;
 using std::reverse;
-using std::sqrt;
 using std::swap;
 using std::vector;
 
-vector<Node> Solution::coords = vector<Node>{};
-vector<unsigned int> Solution::demand = vector<unsigned int>{};
-double Solution::avg_dist = 0;
+/* Longest run of nodes relocated by Or-opt */
+static unsigned int const OROPT_MAX = 3;
 
-/* Empty constructor */
+/* Attempts to find a node of another route for 2-opt* */
+static unsigned int const TWOOPT_TRIES = 8;
+
+/* Rejections after which a node is mostly skipped, and redraws to skip it */
+static unsigned char const IDLE_LIMIT = 16;
+static unsigned int const PICK_TRIES = 4;
+
+/* Empty constructor, belonging to no context yet */
 Solution::Solution()
-	: r_int(0, 100)
-	, r_double(0.0, 1.0)
+	: pos()
+	, route()
+	, total(0.0)
+	, thr(0.0)
+	, overcap(0)
+	, risky(0)
+	, vehicles(0)
+	, journal()
+	, saved_total(0.0)
+	, saved_overcap(0)
+	, saved_risky(0)
+	, saved_partial(true)
+	, saved_a(0)
+	, saved_len(0)
+	, lanes()
+	, lane()
+	, saved_perm()
+	, saved_first()
+	, saved_second()
+	, saved_route{0, 0}
+	, saved_lo(0)
+	, saved_vehicles(0)
+	, idle()
+	, anchor(0)
+	, ctx(nullptr)
 	, perm()
 	, orig()
 {}
 
 /* Copy constructor */
 Solution::Solution(Solution const &other)
-	: r_int(0, (unsigned int)Solution::coords.size() - 1)
-	, r_double(0.0, 1.0)
+	: pos(other.pos)
+	, route(other.route)
+	, total(other.total)
+	, thr(other.thr)
+	, overcap(other.overcap)
+	, risky(other.risky)
+	, vehicles(other.vehicles)
+	, journal()
+	, saved_total(other.saved_total)
+	, saved_overcap(other.saved_overcap)
+	, saved_risky(other.saved_risky)
+	, saved_partial(other.saved_partial)
+	, saved_a(other.saved_a)
+	, saved_len(other.saved_len)
+	, lanes(other.lanes)
+	, lane()
+	, saved_perm()
+	, saved_first()
+	, saved_second()
+	, saved_route{0, 0}
+	, saved_lo(0)
+	, saved_vehicles(0)
+	, idle(other.idle)
+	, anchor(other.anchor)
+	, ctx(other.ctx)
 	, perm(other.perm)
 	, orig(other.orig)
-{}
+{
+	reserve();
+}
+
+/*
+ * Copy assignment. Buffers of equally sized solutions are reused, so taking
+ * snapshots does not allocate.
+ */
+Solution &Solution::operator=(Solution const &other)
+{
+	if (this == &other)
+		return *this;
+
+	pos = other.pos;
+	route = other.route;
+	total = other.total;
+	thr = other.thr;
+	overcap = other.overcap;
+	risky = other.risky;
+	vehicles = other.vehicles;
+	journal.clear();
+	saved_total = other.saved_total;
+	saved_overcap = other.saved_overcap;
+	saved_risky = other.saved_risky;
+	saved_partial = other.saved_partial;
+	saved_a = other.saved_a;
+	saved_len = other.saved_len;
+	lanes = other.lanes;
+	idle = other.idle;
+	anchor = other.anchor;
+	ctx = other.ctx;
+	perm = other.perm;
+	orig = other.orig;
+	reserve();
+	return *this;
+}
+
+/* Grow scratch buffers once, so applying movements never allocates */
+void Solution::reserve(void)
+{
+	size_t k = perm.size();
+	journal.reserve(k);
+	lane.reserve(k);
+	saved_perm.reserve(k);
+	saved_first.reserve(k);
+	saved_second.reserve(k);
+}
 
 /* Parametrized constructor */
-Solution::Solution(unsigned int n)
-	: r_int(0, n - 1)
-	, r_double(0.0, 1.0)
+Solution::Solution(Context const &_ctx, unsigned int n)
+	: pos()
+	, route()
+	, total(0.0)
+	, thr(0.0)
+	, overcap(0)
+	, risky(0)
+	, vehicles(0)
+	, journal()
+	, saved_total(0.0)
+	, saved_overcap(0)
+	, saved_risky(0)
+	, saved_partial(true)
+	, saved_a(0)
+	, saved_len(0)
+	, lanes()
+	, lane()
+	, saved_perm()
+	, saved_first()
+	, saved_second()
+	, saved_route{0, 0}
+	, saved_lo(0)
+	, saved_vehicles(0)
+	, idle()
+	, anchor(0)
+	, ctx(&_ctx)
 	, perm()
 	, orig(n, true)
 {
@@ -73,226 +200,922 @@ Solution::Solution(unsigned int n)
 		perm.push_back(i);
 }
 
+/*
+ * Random node to start a movement from. Nodes whose proposals were rejected
+ * too often since their surroundings last changed are redrawn a few times.
+ */
+unsigned int Solution::pick(Prng &rng)
+{
+	unsigned int k = (unsigned int)perm.size();
+	unsigned int x = rng.below(k);
+	for (unsigned int tries = 0; ctx->near_k && tries < PICK_TRIES
+		&& idle[x] >= IDLE_LIMIT; tries++)
+		x = rng.below(k);
+	anchor = x;
+	return x;
+}
+
+/* Random node among the closest ones to another node */
+unsigned int Solution::candidate(Prng &rng, unsigned int node) const
+{
+	unsigned int k = ctx->near_k;
+	return ctx->near[(size_t)node * k + rng.below(k)];
+}
+
 /* Bit flip for neighbor generation */
-void Solution::flip(void)
+Move Solution::flip(Prng &rng)
 {
-	/* At least one 1 bit is required, so flip until condition is met */
-	random_device rd;
-	do {
-		/* Flip random bit */
-		unsigned to_flp = r_int(rd);
-		orig.at(to_flp) = !orig.at(to_flp);
-	} while (all_of(orig.begin(), orig.end(), [](bool i) { return !i; }));
+	unsigned int k = (unsigned int)perm.size();
+	unsigned int to_flp = pick(rng);
+
+	/*
+	 * At least one 1 bit is required. Flipping the only one left forces a
+	 * second random flip, which just moves the single route end.
+	 */
+	if (orig[to_flp] && vehicles == 1)
+		return Move{Move::ROTATE, to_flp, rng.below(k), 0};
+	return Move{Move::FLIP, to_flp, to_flp, 0};
 }
 
-/* 2-opt for neighbor generation */
-void Solution::kopt(void)
+/*
+ * 2-opt for neighbor generation. Reversing the positions between a node and
+ * a close one makes them neighbors.
+ */
+Move Solution::kopt(Prng &rng)
 {
-	/* Choose 2 random indexes. Force them to be different. */
-	random_device rd;
-	unsigned int m;
+	/* Choose 2 indexes. Force them to be different. */
+	unsigned int k = (unsigned int)perm.size();
+	unsigned int x = pick(rng);
+	unsigned int m = pos[x];
 	unsigned int n;
-	do {
-		m = r_int(rd);
-		n = r_int(rd);
-	} while (m == n);
+	if (ctx->near_k) {
+		n = pos[candidate(rng, x)];
+	} else {
+		do {
+			n = rng.below(k);
+		} while (m == n);
+	}
 
 	/* Force m to be smaller than n */
 	if (m > n)
 		swap(m, n);
 
 	/* Reverse nodes from index m to n, effectively doing 2-opt */
-	reverse(perm.begin() + m, perm.begin() + n);
+	return Move{Move::KOPT, m, n, 0};
 }
 
-/* Find any neighbor */
-void Solution::any_neighbor(void)
+/*
+ * Relocation of c nodes from a picked one on, fewer if its route ends. They
+ * go right after a close node if possible.
+ */
+Move Solution::relocate(Prng &rng, unsigned int c)
 {
-	/* Randomly do bit-flip or 2-opt */
-	random_device rd;
-	if (r_double(rd) < 0.5)
-		flip();
-	else
-		kopt();
+	unsigned int k = (unsigned int)perm.size();
+	unsigned int x = pick(rng);
+	unsigned int r = lanes.route_of(x);
+	unsigned int i = lanes.position(x);
+	c = min(c, lanes.length(r) - i);
+
+	/* Anywhere out of the relocated nodes */
+	unsigned int y = ctx->near_k ? candidate(rng, x) : x;
+	while (lanes.route_of(y) == r && lanes.position(y) >= i
+		&& lanes.position(y) < i + c)
+		y = rng.below(k);
+	return Move{Move::RELOCATE, x, y, c};
+}
+
+/*
+ * Exchange of two nodes. The second one is next to a node close to the
+ * first one, so they end up neighbors.
+ */
+Move Solution::exchange(Prng &rng)
+{
+	unsigned int k = (unsigned int)perm.size();
+	unsigned int x = pick(rng);
+	unsigned int y;
+	if (ctx->near_k) {
+		unsigned int c = candidate(rng, x);
+		unsigned int p = orig[c] ? pos[c] + k - 1 : pos[c] + 1;
+		y = perm[p % k];
+		if (y == x)
+			y = c;
+	} else {
+		do {
+			y = rng.below(k);
+		} while (x == y);
+	}
+	return Move{Move::EXCHANGE, x, y, 0};
+}
+
+/*
+ * 2-opt* between a node and another route, or a bit flip. The other route
+ * is cut right before a node close to the first one, so they end up linked.
+ */
+Move Solution::twoopt(Prng &rng)
+{
+	unsigned int k = (unsigned int)perm.size();
+	unsigned int x = pick(rng);
+	unsigned int r = lanes.route_of(x);
+	for (unsigned int tries = 0; tries < TWOOPT_TRIES; tries++) {
+		unsigned int y = ctx->near_k ? candidate(rng, x) : rng.below(k);
+		unsigned int s = lanes.route_of(y);
+		if (s == r)
+			continue;
+		if (ctx->near_k && lanes.position(y) > 0)
+			y = lanes.stop(s, lanes.position(y) - 1).node;
+		return Move{Move::TWOOPT, x, y, 0};
+	}
+	return flip(rng);
 }
 
-/* Evaluate current solution cost */
+/* Find any neighbor, as weighted by the neighborhood mix */
+Move Solution::any_neighbor(Prng &rng)
+{
+	double u = rng.real();
+	unsigned int m = 0;
+	while (u >= ctx->cfg.mix[m])
+		m++;
+
+	/* Movements among routes need a few nodes and no wrapping route */
+	if (m > MOVE_KOPT) {
+		if (perm.size() <= OROPT_MAX)
+			return flip(rng);
+		unwrap();
+	}
+
+	switch (m) {
+	case MOVE_FLIP:
+		return flip(rng);
+	case MOVE_KOPT:
+		return kopt(rng);
+	case MOVE_RELOCATE:
+		return relocate(rng, 1);
+	case MOVE_OROPT:
+		return relocate(rng, 2 + rng.below(OROPT_MAX - 1));
+	case MOVE_EXCHANGE:
+		return exchange(rng);
+	case MOVE_TWOOPT:
+	default:
+		return twoopt(rng);
+	}
+}
+
+/* Evaluate current solution cost, with the best kernel of this CPU */
 double Solution::eval(double threshold)
 {
-	/* Get solution cost. If infesaible, punish evaluation. */
-	double cost = 0.0;
-	unsigned int k = (unsigned int)Solution::coords.size();
+	return Evaluator::eval(ctx->distance, ctx->demand, perm, orig, threshold,
+		ctx->avg_dist, ctx->cfg.v_cap);
+}
 
-	/* Start from the deposit */
-	unsigned int st = 0;
-	while (!orig.at(perm.at(st++)));
-
-	/* Store money and risk for each vehicle loop */
-	unsigned int v_money = 0;
-	double v_risk = 0;
-
-	/* Variables to improve code legibility */
-	double dx;
-	double dy;
-	double dist;
-
-	/* Oterate through each vehicle loop */
-	for (unsigned int i = 0; i < k; i++) {
-		/* Check if coming from deposit */
-		if (orig.at(perm.at((st + i - 1 + k) % k))) {
-			v_money = 0;
-			v_risk = 0;
-
-			/* Get distance from deposit to current node */
-			dx = coords.at(perm.at((i + st) % k)).x;
-			dy = coords.at(perm.at((i + st) % k)).y;
-			dist = sqrt(dx * dx + dy * dy);
-
-			/* Add cost, update money and risk */
-			cost += dist;
-			v_risk += 0;
-			v_money += demand.at(perm.at((i + st) % k));
+/* Node found at position p once movement mv is applied */
+inline unsigned int Solution::node_at(Move const &mv, unsigned int p) const
+{
+	if (mv.kind == Move::KOPT && p >= mv.a && p < mv.b)
+		return perm[mv.a + mv.b - 1 - p];
+	return perm[p];
+}
+
+/* Whether a node ends its route once movement mv is applied */
+inline bool Solution::end_at(Move const &mv, unsigned int node) const
+{
+	bool end = orig[node];
+	if (mv.kind == Move::FLIP && node == mv.a)
+		return !end;
+	if (mv.kind == Move::ROTATE && mv.a != mv.b)
+		return node == mv.b ? true : (node == mv.a ? false : end);
+	return end;
+}
+
+/*
+ * Get the positions [a, a + len) holding every route touched by movement mv.
+ * Both before and after the movement, a starts a route and a + len - 1 ends
+ * one. Returns false if the whole solution has to be walked instead.
+ */
+bool Solution::span(Move const &mv, unsigned int &a, unsigned int &len) const
+{
+	unsigned int k = (unsigned int)perm.size();
+	unsigned int b;
+
+	switch (mv.kind) {
+	case Move::FLIP:
+		/* Route holding the flipped node, plus the next one on a merge */
+		a = pos[mv.a];
+		while (!orig[perm[(a + k - 1) % k]])
+			a = (a + k - 1) % k;
+		b = orig[mv.a] ? (pos[mv.a] + 1) % k : pos[mv.a];
+		while (!orig[perm[b]])
+			b = (b + 1) % k;
+		len = (b + k - a) % k + 1;
+		return true;
+	case Move::KOPT:
+		/* Routes overlapping the reversed segment and its right edge */
+		a = mv.a;
+		while (a > 0 && !orig[perm[a - 1]])
+			a--;
+		b = mv.b;
+		while (b < k - 1 && !orig[perm[b]])
+			b++;
+		len = b - a + 1;
+
+		/* Routes wrapping around the permutation are not handled */
+		return (a > 0 || orig[perm[k - 1]]) && orig[perm[b]];
+	case Move::ROTATE:
+	case Move::RELOCATE:
+	case Move::EXCHANGE:
+	case Move::TWOOPT:
+	default:
+		return false;
+	}
+}
+
+/*
+ * Walk the routes in positions [a, a + len) as seen after movement mv.
+ * Add their cost, over capacity and over risk counts, and maybe store them as
+ * current.
+ */
+void Solution::walk(Move const &mv, unsigned int a, unsigned int len,
+	double &cost, unsigned int &over, unsigned int &risk, bool commit)
+{
+	unsigned int k = (unsigned int)perm.size();
+	Route r{0.0, 0.0, 0, false};
+	bool from_depot = true;
+
+	for (unsigned int i = 0, p = a; i < len; i++, p = p + 1 < k ? p + 1 : 0) {
+		unsigned int c = node_at(mv, p);
+		double dist;
+
+		/* Coming from deposit, start a new route */
+		if (from_depot) {
+			r = Route{ctx->distance.depot(c), 0.0, ctx->demand[c], false};
+			from_depot = false;
 		}
 
-		/* Check if going to deposit, else add node-node distance */
-		if (orig.at(perm.at((st + i) % k))) {
-			/* Distance to deposit */
-			dx = coords.at(perm.at((i + st) % k)).x;
-			dy = coords.at(perm.at((i + st) % k)).y;
-			dist = sqrt(dx * dx + dy * dy);
-
-			/* Add cost, update money and risk */
-			cost += dist;
-			v_risk += v_money * dist;
-			v_money += 0;
+		if (end_at(mv, c)) {
+			/* Go back to deposit */
+			dist = ctx->distance.depot(c);
+			r.cost += dist;
+			r.risk += r.money * dist;
+			from_depot = true;
 		} else {
-			/* Distance to next node */
-			dx = coords.at(perm.at((i + st) % k)).x;
-			dy = coords.at(perm.at((i + st) % k)).y;
-			dx -= coords.at(perm.at((i + st + 1) % k)).x;
-			dy -= coords.at(perm.at((i + st + 1) % k)).y;
-			dist = sqrt(dx * dx + dy * dy);
-
-			/* Add cost, risk and money */
-			cost += dist;
-			v_risk += v_money * dist;
-			v_money += demand.at(perm.at((i + st) % k));
+			/* Go to next node */
+			dist = ctx->distance(c, node_at(mv, p + 1 < k ? p + 1 : 0));
+			r.cost += dist;
+			r.risk += r.money * dist;
+			r.money += ctx->demand[c];
 		}
 
-		/*
-		 * Check if solution is infeasible and punish it.
-		 * Punishment is done by adding the risk of carrying current
-		 * money through the average distance between nodes to the cost.
-		 */
-		if (v_risk > threshold)
-			cost += v_money * avg_dist;
-
-		/* If solution exceeds vehicle capacity, punish with infinity */
-		if (ctx.v_cap && v_money > ctx.v_cap)
-			return dl::infinity();
+		/* Same punishments as a full evaluation */
+		if (r.risk > thr)
+			r.cost += r.money * ctx->avg_dist;
+		if (ctx->cfg.v_cap && r.money > ctx->cfg.v_cap)
+			r.over = true;
+
+		/* Route finished, accumulate it */
+		if (from_depot) {
+			cost += r.cost;
+			over += r.over;
+			risk += r.risk > thr;
+			if (commit)
+				route[c] = r;
+		}
 	}
+}
 
-	return cost;
+/*
+ * Add cached cost, over capacity and over risk counts of the routes in
+ * [a, a + len). Maybe keep them in the journal too.
+ */
+void Solution::cached(unsigned int a, unsigned int len,
+	double &cost, unsigned int &over, unsigned int &risk, bool keep)
+{
+	unsigned int k = (unsigned int)perm.size();
+	for (unsigned int i = 0, p = a; i < len; i++, p = p + 1 < k ? p + 1 : 0) {
+		if (orig[perm[p]]) {
+			cost += route[perm[p]].cost;
+			over += route[perm[p]].over;
+			risk += route[perm[p]].risk > thr;
+			if (keep)
+				journal.push_back(make_pair(perm[p], route[perm[p]]));
+		}
+	}
 }
 
-/* Initialize solution by a greedy method */
-void Solution::greedy_init(void)
+/* Change permutation and flags as movement mv says */
+void Solution::perform(Move const &mv)
 {
-	/* Calculate average distance between nodes. */
-	avg_dist = Heuristic::avg_dist(coords);
-	/* Generate initial solution using a pseudo-prim algorithm */
-	Heuristic::prim(coords, perm);
+	switch (mv.kind) {
+	case Move::FLIP:
+		orig[mv.a] = !orig[mv.a];
+		if (orig[mv.a])
+			vehicles++;
+		else
+			vehicles--;
+		break;
+	case Move::ROTATE:
+		orig[mv.a] = false;
+		orig[mv.b] = true;
+		break;
+	case Move::KOPT:
+		reverse(perm.begin() + mv.a, perm.begin() + mv.b);
+		for (unsigned int i = mv.a; i < mv.b; i++)
+			pos[perm[i]] = i;
+		break;
+	case Move::RELOCATE:
+	case Move::EXCHANGE:
+	case Move::TWOOPT:
+	default:
+		break;
+	}
 }
 
-/* Method to get solution size  */
-unsigned int Solution::size(void)
+/*
+ * Rotate the permutation so no route wraps around it, then every route is a
+ * range of positions. Nothing else changes.
+ */
+void Solution::unwrap(void)
 {
-	return (unsigned int)Solution::coords.size();
+	unsigned int k = (unsigned int)perm.size();
+	if (orig[perm[k - 1]])
+		return;
+
+	unsigned int p = 0;
+	while (!orig[perm[p]])
+		p++;
+	rotate(perm.begin(), perm.begin() + p + 1, perm.end());
+	for (unsigned int i = 0; i < k; i++)
+		pos[perm[i]] = i;
 }
 
-/* Methods to add coordinates to solution */
-void Solution::push_back(Node n)
+/* Rebuild the explicit routes in positions [a, a + len), whole routes */
+void Solution::relane(unsigned int a, unsigned int len)
 {
-	Solution::coords.push_back(n);
+	unsigned int k = (unsigned int)perm.size();
+
+	/* Release routes holding those nodes, they are all rebuilt */
+	for (unsigned int i = 0, p = a; i < len; i++, p = p + 1 < k ? p + 1 : 0)
+		if (lanes.used(lanes.route_of(perm[p])))
+			lanes.assign(lanes.route_of(perm[p]), nullptr, 0);
+
+	lane.clear();
+	for (unsigned int i = 0, p = a; i < len; i++, p = p + 1 < k ? p + 1 : 0) {
+		lane.push_back(perm[p]);
+		if (orig[perm[p]]) {
+			lanes.add(lane.data(), (unsigned int)lane.size());
+			lane.clear();
+		}
+	}
 }
 
-/* Print a solution sub-circuits */
-void Solution::print(double threshold)
+/*
+ * Pieces of the routes of nodes a and b once movement mv, one among routes,
+ * is applied. If both nodes share a route, the second one is left empty.
+ */
+void Solution::pieces(Move const &mv, Piece *first, unsigned int &n_first,
+	Piece *second, unsigned int &n_second) const
 {
-	/* Total cost */
-	cout.precision(6);
-	cout << fixed << eval(threshold) << '\n';
+	unsigned int ra = lanes.route_of(mv.a);
+	unsigned int rb = lanes.route_of(mv.b);
+	unsigned int ma = lanes.length(ra);
+	unsigned int mb = lanes.length(rb);
+	unsigned int i = lanes.position(mv.a);
+	unsigned int j = lanes.position(mv.b);
+	unsigned int c = mv.c;
+
+	n_first = 0;
+	n_second = 0;
+	switch (mv.kind) {
+	case Move::RELOCATE:
+		if (ra != rb) {
+			first[n_first++] = Piece{ra, 0, i};
+			first[n_first++] = Piece{ra, i + c, ma};
+			second[n_second++] = Piece{rb, 0, j + 1};
+			second[n_second++] = Piece{ra, i, i + c};
+			second[n_second++] = Piece{rb, j + 1, mb};
+		} else if (j < i) {
+			first[n_first++] = Piece{ra, 0, j + 1};
+			first[n_first++] = Piece{ra, i, i + c};
+			first[n_first++] = Piece{ra, j + 1, i};
+			first[n_first++] = Piece{ra, i + c, ma};
+		} else {
+			first[n_first++] = Piece{ra, 0, i};
+			first[n_first++] = Piece{ra, i + c, j + 1};
+			first[n_first++] = Piece{ra, i, i + c};
+			first[n_first++] = Piece{ra, j + 1, ma};
+		}
+		break;
+	case Move::EXCHANGE:
+		if (ra != rb) {
+			first[n_first++] = Piece{ra, 0, i};
+			first[n_first++] = Piece{rb, j, j + 1};
+			first[n_first++] = Piece{ra, i + 1, ma};
+			second[n_second++] = Piece{rb, 0, j};
+			second[n_second++] = Piece{ra, i, i + 1};
+			second[n_second++] = Piece{rb, j + 1, mb};
+		} else {
+			if (j < i)
+				swap(i, j);
+			first[n_first++] = Piece{ra, 0, i};
+			first[n_first++] = Piece{ra, j, j + 1};
+			first[n_first++] = Piece{ra, i + 1, j};
+			first[n_first++] = Piece{ra, i, i + 1};
+			first[n_first++] = Piece{ra, j + 1, ma};
+		}
+		break;
+	case Move::TWOOPT:
+		first[n_first++] = Piece{ra, 0, i + 1};
+		first[n_first++] = Piece{rb, j + 1, mb};
+		second[n_second++] = Piece{rb, 0, j + 1};
+		second[n_second++] = Piece{ra, i + 1, ma};
+		break;
+	case Move::FLIP:
+	case Move::ROTATE:
+	case Move::KOPT:
+	default:
+		break;
+	}
+}
+
+/*
+ * Cost variation caused by movement mv among routes. New routes are built
+ * from pieces of the current ones, in constant time per piece.
+ */
+double Solution::reroute(Move const &mv, bool *feasible)
+{
+	Piece piece[2][5];
+	unsigned int n[2];
+	unsigned int r[2] = {lanes.route_of(mv.a), lanes.route_of(mv.b)};
+	double before = 0.0;
+	double after = 0.0;
+	unsigned int over_before = 0;
+	unsigned int over_after = 0;
+	unsigned int risk_before = 0;
+	unsigned int risk_after = 0;
+
+	pieces(mv, piece[0], n[0], piece[1], n[1]);
+	for (unsigned int x = 0; x < 2; x++) {
+		if (x && r[1] == r[0])
+			break;
+
+		/* Current route, as cached at its end */
+		unsigned int end = lanes.stop(r[x], lanes.length(r[x]) - 1).node;
+		Route const &old = route[end];
+		before += old.cost;
+		over_before += old.over;
+		risk_before += old.risk > thr;
+
+		/* Route after the movement */
+		Label l = lanes.open();
+		for (unsigned int p = 0; p < n[x]; p++)
+			if (piece[x][p].j > piece[x][p].i)
+				lanes.append(l, piece[x][p].r, piece[x][p].i,
+					piece[x][p].j);
+		bool over_risk;
+		double c = lanes.close(l, &over_risk);
+		if (isinf(c))
+			over_after++;
+		else
+			after += c;
+		risk_after += over_risk;
+	}
+
+	if (feasible)
+		*feasible = !(overcap - over_before + over_after)
+			&& !(risky - risk_before + risk_after);
+
+	/* Any vehicle over capacity makes the solution infinitely bad */
+	if (overcap - over_before + over_after)
+		return dl::infinity();
+	if (overcap)
+		return -dl::infinity();
+	return after - before;
+}
 
-	/* Required cars*/
-	unsigned int cars = (unsigned int)count(orig.begin(), orig.end(), true);
-	cout << cars << '\n';
+/*
+ * Apply movement mv among routes. Explicit routes are rebuilt from pieces,
+ * and the permutation range from the first to the last touched route is
+ * rewritten, shifting routes in between.
+ */
+double Solution::shift(Move const &mv)
+{
+	unsigned int k = (unsigned int)perm.size();
+	Move none{Move::FLIP, k, k, 0};
+	Piece piece[2][5];
+	unsigned int n[2];
+	unsigned int r[2] = {lanes.route_of(mv.a), lanes.route_of(mv.b)};
+	unsigned int routes = r[1] == r[0] ? 1 : 2;
+	unsigned int start[2];
+	unsigned int len[2];
+	double before = 0.0;
+	double after = 0.0;
+	unsigned int over_before = 0;
+	unsigned int over_after = 0;
+	unsigned int risk_before = 0;
+	unsigned int risk_after = 0;
 
-	/* Queue of print-pending circuits (each represented as a vector) */
-	queue< vector<unsigned int> > circuits;
+	/* Remember what is about to change */
+	journal.clear();
+	saved_total = total;
+	saved_overcap = overcap;
+	saved_risky = risky;
+	saved_partial = true;
+	saved_vehicles = vehicles;
+	saved_first.clear();
+	saved_second.clear();
+	saved_route[0] = r[0];
+	saved_route[1] = r[1];
+	for (unsigned int x = 0; x < routes; x++) {
+		len[x] = lanes.length(r[x]);
+		start[x] = pos[lanes.stop(r[x], 0).node];
+		cached(start[x], len[x], before, over_before, risk_before, true);
+		vector<unsigned int> &nodes = x ? saved_second : saved_first;
+		for (unsigned int t = 0; t < len[x]; t++)
+			nodes.push_back(lanes.stop(r[x], t).node);
+	}
 
-	/* Move to the start of a circuit */
-	unsigned int n = (unsigned int)orig.size();
+	/* New routes, one after the other */
+	pieces(mv, piece[0], n[0], piece[1], n[1]);
+	lane.clear();
+	unsigned int split = 0;
+	for (unsigned int x = 0; x < routes; x++) {
+		for (unsigned int p = 0; p < n[x]; p++)
+			for (unsigned int t = piece[x][p].i; t < piece[x][p].j; t++)
+				lane.push_back(lanes.stop(piece[x][p].r, t).node);
+		if (!x)
+			split = (unsigned int)lane.size();
+	}
+	if (routes > 1)
+		lanes.assign(r[0], lane.data(), split, r[1], lane.data() + split,
+			(unsigned int)lane.size() - split);
+	else
+		lanes.assign(r[0], lane.data(), split);
+
+	/* Rewrite the permutation, earlier route first */
+	unsigned int e = routes > 1 && start[1] < start[0] ? 1 : 0;
+	unsigned int l = routes > 1 ? 1 - e : e;
+	saved_lo = start[e];
+	saved_perm.assign(perm.begin() + start[e],
+		perm.begin() + start[l] + len[l]);
+	unsigned int p = start[e];
+	for (unsigned int t = 0; t < lanes.length(r[e]); t++)
+		perm[p++] = lanes.stop(r[e], t).node;
+	if (routes > 1) {
+		for (unsigned int q = len[e]; q < start[l] - start[e]; q++)
+			perm[p++] = saved_perm[q];
+		for (unsigned int t = 0; t < lanes.length(r[l]); t++)
+			perm[p++] = lanes.stop(r[l], t).node;
+	}
+	for (unsigned int q = saved_lo; q < p; q++)
+		pos[perm[q]] = q;
+
+	/* Route ends, some routes may be gone */
+	for (unsigned int x = 0; x < routes; x++) {
+		vector<unsigned int> const &nodes = x ? saved_second : saved_first;
+		for (unsigned int t = 0; t < nodes.size(); t++)
+			orig[nodes[t]] = false;
+	}
+	for (unsigned int x = 0; x < routes; x++) {
+		unsigned int m = lanes.length(r[x]);
+		if (m) {
+			orig[lanes.stop(r[x], m - 1).node] = true;
+			walk(none, pos[lanes.stop(r[x], 0).node], m, after,
+				over_after, risk_after, true);
+		} else {
+			vehicles--;
+		}
+	}
+	total += after - before;
+	overcap += over_after - over_before;
+	risky += risk_after - risk_before;
+
+	/* Any vehicle over capacity makes the solution infinitely bad */
+	if (overcap)
+		return dl::infinity();
+	if (saved_overcap)
+		return -dl::infinity();
+	return total - saved_total;
+}
+
+/* Revert the last movement among routes */
+void Solution::unshift(void)
+{
+	unsigned int *r = saved_route;
+
+	/* Permutation range and its positions */
+	for (unsigned int q = 0; q < saved_perm.size(); q++) {
+		perm[saved_lo + q] = saved_perm[q];
+		pos[saved_perm[q]] = saved_lo + q;
+	}
+
+	/* Explicit routes and their ends */
+	if (!saved_second.empty())
+		lanes.assign(r[0], saved_first.data(),
+			(unsigned int)saved_first.size(), r[1],
+			saved_second.data(), (unsigned int)saved_second.size());
+	else
+		lanes.assign(r[0], saved_first.data(),
+			(unsigned int)saved_first.size());
+	for (unsigned int t = 0; t < saved_first.size(); t++)
+		orig[saved_first[t]] = false;
+	for (unsigned int t = 0; t < saved_second.size(); t++)
+		orig[saved_second[t]] = false;
+	orig[saved_first.back()] = true;
+	if (!saved_second.empty())
+		orig[saved_second.back()] = true;
+	vehicles = saved_vehicles;
+
+	/* Restore overwritten routes instead of walking them again */
+	for (unsigned int i = 0; i < journal.size(); i++)
+		route[journal[i].first] = journal[i].second;
+	total = saved_total;
+	overcap = saved_overcap;
+	risky = saved_risky;
+	journal.clear();
+}
+
+/* Build per-route state so movements can be evaluated incrementally */
+void Solution::track(double threshold)
+{
+	unsigned int k = (unsigned int)perm.size();
+	Move none{Move::FLIP, k, k, 0};
+
+	thr = threshold;
+	pos.assign(k, 0);
+	route.assign(k, Route{0.0, 0.0, 0, false});
+	for (unsigned int i = 0; i < k; i++)
+		pos[perm[i]] = i;
+	vehicles = (unsigned int)count(orig.begin(), orig.end(), true);
+
+	/* Start right after any route end and walk everything */
 	unsigned int st = 0;
-	while (!orig.at(perm.at(st++)));
+	while (!orig[perm[st++]]);
+	total = 0.0;
+	overcap = 0;
+	risky = 0;
+	walk(none, st % k, k, total, overcap, risky, true);
+
+	/* And keep explicit routes too */
+	lanes.read(*this, thr);
+
+	/* Don't-look bits survive, unless the solution size changed */
+	if (idle.size() != k)
+		idle.assign(k, 0);
+	reserve();
+}
+
+/* Cost variation caused by movement mv, touching only involved routes */
+double Solution::delta(Move const &mv, bool *feasible)
+{
+	unsigned int k = (unsigned int)perm.size();
+	double before = 0.0;
+	double after = 0.0;
+	unsigned int over_before = 0;
+	unsigned int over_after = 0;
+	unsigned int risk_before = 0;
+	unsigned int risk_after = 0;
+	unsigned int a;
+	unsigned int len;
 
-	/* Iterate through and add each circuit to queue */
-	for (unsigned int i = 0; i < n; i++) {
-		if (orig.at(perm.at((st + i - 1 + n) % n)))
-			circuits.push(vector<unsigned int>{});
-		circuits.back().push_back(perm.at((st + i) % n));
+	if (feasible)
+		*feasible = !overcap && !risky;
+	if (mv.kind == Move::ROTATE && mv.a == mv.b)
+		return 0.0;
+	if (mv.kind >= Move::RELOCATE)
+		return reroute(mv, feasible);
+
+	if (span(mv, a, len)) {
+		cached(a, len, before, over_before, risk_before, false);
+	} else {
+		/* Walk the whole solution from any route start */
+		a = 0;
+		while (!end_at(mv, node_at(mv, a++)));
+		a %= k;
+		len = k;
+		before = total;
+		over_before = overcap;
+		risk_before = risky;
 	}
+	walk(mv, a, len, after, over_after, risk_after, false);
 
-	/* For each circuit print cost, risk and nodes */
-	while (!circuits.empty()) {
-		vector<unsigned int> circuit = circuits.front();
-		circuits.pop();
-		unsigned int m = (unsigned int)circuit.size();
-
-		/* Temporary variables */
-		double risk = 0.0;
-		double cost = 0.0;
-		unsigned int money = 0;
-
-		/* Useful variables (improve legibility) */
-		double dx;
-		double dy;
-		double dist;
+	if (feasible)
+		*feasible = !(overcap - over_before + over_after)
+			&& !(risky - risk_before + risk_after);
+
+	/* Any vehicle over capacity makes the solution infinitely bad */
+	if (overcap - over_before + over_after)
+		return dl::infinity();
+	if (overcap)
+		return -dl::infinity();
+	return after - before;
+}
+
+/* Node the last movement proposed started from */
+unsigned int Solution::picked(void) const
+{
+	return anchor;
+}
+
+/* A movement proposed from a node was turned down */
+void Solution::reject(unsigned int node)
+{
+	if (idle[node] < UCHAR_MAX)
+		idle[node]++;
+}
+
+/* Look around the nodes whose neighbors movement mv changes again */
+void Solution::wake(Move const &mv)
+{
+	unsigned int k = (unsigned int)perm.size();
+	switch (mv.kind) {
+	case Move::KOPT:
+		idle[perm[mv.a]] = 0;
+		idle[perm[mv.b - 1]] = 0;
+		if (mv.a > 0)
+			idle[perm[mv.a - 1]] = 0;
+		if (mv.b < k)
+			idle[perm[mv.b]] = 0;
+		break;
+	case Move::FLIP:
+	case Move::ROTATE:
+	case Move::RELOCATE:
+	case Move::EXCHANGE:
+	case Move::TWOOPT:
+	default:
+		idle[mv.a] = 0;
+		idle[mv.b] = 0;
+		break;
+	}
+}
+
+/*
+ * Apply movement mv and update the state of involved routes in place.
+ * Returns the cost variation, just like delta does.
+ */
+double Solution::apply(Move const &mv)
+{
+	unsigned int k = (unsigned int)perm.size();
+	Move none{Move::FLIP, k, k, 0};
+	double before = 0.0;
+	double after = 0.0;
+	unsigned int over_before = 0;
+	unsigned int over_after = 0;
+	unsigned int risk_before = 0;
+	unsigned int risk_after = 0;
+	unsigned int a;
+	unsigned int len;
+
+	wake(mv);
+	if (mv.kind >= Move::RELOCATE)
+		return shift(mv);
+
+	/* Remember what is about to change */
+	journal.clear();
+	saved_total = total;
+	saved_overcap = overcap;
+	saved_risky = risky;
+	saved_partial = true;
+	if (mv.kind == Move::ROTATE && mv.a == mv.b)
+		return 0.0;
+
+	saved_partial = span(mv, a, len);
+	if (saved_partial)
+		cached(a, len, before, over_before, risk_before, true);
+
+	/* Actually move */
+	perform(mv);
+
+	if (saved_partial) {
+		walk(none, a, len, after, over_after, risk_after, true);
+		total += after - before;
+		overcap += over_after - over_before;
+		risky += risk_after - risk_before;
+		relane(a, len);
+		saved_a = a;
+		saved_len = len;
+	} else {
+		track(thr);
+	}
+
+	/* Any vehicle over capacity makes the solution infinitely bad */
+	if (overcap)
+		return dl::infinity();
+	if (saved_overcap)
+		return -dl::infinity();
+	return total - saved_total;
+}
 
-		/* Distance & risk from deposit to first node */
-		dx = coords.at(circuit.at(0)).x;
-		dy = coords.at(circuit.at(0)).y;
-		dist = sqrt(dx * dx + dy * dy);
-
-		/* Move from deposit to first node */
-		cost += dist;
-		risk += dist * money;
-		money += demand.at(circuit.at(0));
-
-		/* Distance & risk among nodes */
-		for (unsigned int i = 0; i < m - 1; i++) {
-			dx = coords.at(circuit.at(i)).x;
-			dy = coords.at(circuit.at(i)).y;
-			dx -= coords.at(circuit.at(i + 1)).x;
-			dy -= coords.at(circuit.at(i + 1)).y;
-			dist = sqrt(dx * dx + dy * dy);
-
-			cost += dist;
-			risk += money * dist;
-			money += demand.at(circuit.at(i));
+/* Revert movement mv, which must be the last one applied */
+void Solution::undo(Move const &mv)
+{
+	if (mv.kind == Move::ROTATE && mv.a == mv.b)
+		return;
+	if (mv.kind >= Move::RELOCATE) {
+		unshift();
+		return;
+	}
+
+	/* Every movement is its own inverse, except for rotations */
+	if (mv.kind == Move::ROTATE)
+		perform(Move{Move::ROTATE, mv.b, mv.a, 0});
+	else
+		perform(mv);
+
+	/* Restore overwritten routes instead of walking them again */
+	if (saved_partial) {
+		for (unsigned int i = 0; i < journal.size(); i++)
+			route[journal[i].first] = journal[i].second;
+		total = saved_total;
+		overcap = saved_overcap;
+		risky = saved_risky;
+		relane(saved_a, saved_len);
+	} else {
+		track(thr);
+	}
+	journal.clear();
+}
+
+/*
+ * Move a node right after the node where it costs least, feasible places
+ * first, unless it is best left where it is. Tracked solutions only, every
+ * place is evaluated incrementally. Returns the cost variation.
+ */
+double Solution::reinsert(unsigned int node)
+{
+	unsigned int k = (unsigned int)perm.size();
+	Move best{Move::RELOCATE, node, node, 1};
+	double best_diff = 0.0;
+	bool best_feasible = feasible();
+
+	for (unsigned int other = 0; other < k; other++) {
+		Move mv{Move::RELOCATE, node, other, 1};
+		if (other == node)
+			continue;
+		bool ok;
+		double diff = delta(mv, &ok);
+		if (isinf(diff) && diff > 0.0)
+			continue;
+		if ((ok && !best_feasible) || (ok == best_feasible
+			&& diff < best_diff)) {
+			best = mv;
+			best_diff = diff;
+			best_feasible = ok;
 		}
+	}
 
-		/* Distance & risk from last node to deposit */
-		dx = coords.at(circuit.at(m - 1)).x;
-		dy = coords.at(circuit.at(m - 1)).y;
-		dist = sqrt(dx * dx + dy * dy);
+	if (best.b == node)
+		return 0.0;
+	return apply(best);
+}
+
+/* Cached cost of the current solution */
+double Solution::cost(void) const
+{
+	return overcap ? dl::infinity() : total;
+}
+
+/* Whether no route goes over capacity nor over the risk threshold */
+bool Solution::feasible(void) const
+{
+	return !overcap && !risky;
+}
+
+/* Vehicles the tracked solution needs, one per route */
+unsigned int Solution::fleet(void) const
+{
+	return vehicles;
+}
+
+/* Initialize solution by a greedy method */
+void Solution::greedy_init(void)
+{
+	/* Generate initial solution using a pseudo-prim algorithm */
+	Heuristic::prim(ctx->coords, perm);
+}
 
-		cost += dist;
-		risk += money * dist;
+/* Method to get solution size  */
+unsigned int Solution::size(void)
+{
+	return (unsigned int)ctx->coords.size();
+}
 
-		/* Print cost, risk & route */
-		cout << fixed << cost << '\t' << fixed << risk << "\t0";
-		for (unsigned int i = 0; i < m; i++)
-			cout << "->" << circuit.at(i) + 1;
-		cout << "->0" << '\n';
+/* Print a solution sub-circuits */
+void Solution::print(double threshold, ostream &out)
+{
+	/* Total cost */
+	out.precision(6);
+	out << fixed << eval(threshold) << '\n';
+
+	/* Required cars, one per route */
+	Routes routes(*this, threshold);
+	out << routes.count() << '\n';
+
+	/* For each circuit print cost, risk and nodes */
+	for (unsigned int r = 0; r < routes.ids(); r++) {
+		if (!routes.used(r))
+			continue;
+		out << fixed << routes.distance(r) << '\t' << fixed
+			<< routes.risk(r) << "\t0";
+		for (unsigned int i = 0; i < routes.length(r); i++)
+			out << "->" << routes.stop(r, i).node + 1;
+		out << "->0" << '\n';
 	}
 }
@@ -0,0 +1,429 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "solver.h"
+#include "anytime.h"
+#include "checkpoint.h"
+#include "config.h"
+#include "context.h"
+#include "decompose.h"
+#include "exchange.h"
+#include "heuristic.h"
+#include "loader.h"
+#include "pool.h"
+#include "prng.h"
+#include "sa.h"
+#include "solution.h"
+#include "tempering.h"
+#include "routes.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using std::ceil;
+using std::future;
+using std::invalid_argument;
+using std::max;
+using std::min;
+using std::random_device;
+using std::size_t;
+using std::to_string;
+using std::uint64_t;
+using std::vector;
+
+/* Relative standard error allowed when estimating the average distance */
+static double const AVG_TOLERANCE = 0.001;
+
+/* Id of nodes left out of a renumbering */
+static unsigned int const NONE = ~0u;
+
+/* Load an instance into a context, return its greedy solution */
+Solution Solver::prepare(Context &ctx, Instance &inst, unsigned int v_cap,
+	Pool &pool)
+{
+	unsigned int nodes = (unsigned int)inst.coords.size() + 1;
+	ctx.cfg.risk_threshold = inst.threshold;
+
+	/* Instance capacity, unless the user set one */
+	ctx.cfg.v_cap = v_cap ? v_cap : inst.capacity;
+
+	/* Prepare the initial solution */
+	Solution sol(ctx, nodes - 1);
+	ctx.demand.swap(inst.demand);
+	ctx.coords.swap(inst.coords);
+
+	/* Precompute distances once, within the memory budget */
+	ctx.distance.build(ctx.coords, (size_t)ctx.cfg.dist_mem << 20);
+
+	/*
+	 * Average distance among nodes, used for punishments. It is computed
+	 * once, exactly or estimated for big instances, and workers only read it.
+	 */
+	if (nodes - 1 <= ctx.cfg.avg_exact)
+		ctx.avg_dist = Heuristic::avg_dist(ctx.distance, pool);
+	else
+		ctx.avg_dist = Heuristic::avg_dist_sampled(ctx.distance,
+			AVG_TOLERANCE);
+
+	/* Candidate partners of each node, which movements try to link it to */
+	ctx.near_k = nodes > 2 ? min(ctx.cfg.neighbors, nodes - 2) : 0;
+	ctx.near = ctx.near_k ? Heuristic::neighbors(ctx.coords, ctx.near_k) :
+		vector<unsigned int>{};
+
+	/* Initial greedy solution, built once and shared by every worker */
+	sol.greedy_init();
+	return sol;
+}
+
+/* Replace a prepared solution by given routes, repairing them */
+void Solver::warm(Solution &sol, Start const &start, double threshold)
+{
+	unsigned int k = (unsigned int)sol.perm.size();
+	vector<bool> seen(k, false);
+
+	/* Known nodes, each on its first route only */
+	sol.perm.clear();
+	sol.orig.assign(k, false);
+	for (unsigned int r = 0; r < start.routes.size(); r++) {
+		unsigned int used = 0;
+		for (unsigned int i = 0; i < start.routes[r].size(); i++) {
+			unsigned int node = start.routes[r][i];
+			if (node >= k || seen[node])
+				continue;
+			seen[node] = true;
+			sol.perm.push_back(node);
+			used++;
+		}
+		if (used)
+			sol.orig[sol.perm.back()] = true;
+	}
+
+	/* Nodes left out start on routes of their own */
+	vector<unsigned int> missing;
+	for (unsigned int node = 0; node < k; node++) {
+		if (seen[node])
+			continue;
+		sol.perm.push_back(node);
+		sol.orig[node] = true;
+		missing.push_back(node);
+	}
+
+	/* Then go where they cost least */
+	sol.track(threshold);
+	for (unsigned int i = 0; i < missing.size(); i++)
+		sol.reinsert(missing[i]);
+}
+
+/* Run restarts of sa on a pool, keep the best */
+static Solution restarts(Context const &ctx, Solution const &sol,
+	double threshold, uint64_t seed, Pool &pool, Checkpoint *saving,
+	Anytime *stream)
+{
+	/* Islands share their best solutions, independent runs do not */
+	Exchange exchange;
+	Exchange *shared = ctx.cfg.mode == MODE_ISLAND ? &exchange : nullptr;
+
+	/* Start solving many restarts, each one with its own seed */
+	unsigned int restarts = ctx.cfg.restarts ? ctx.cfg.restarts : pool.size();
+	vector< future<Solution> > runs(restarts);
+	for (unsigned int i = 0; i < restarts; i++) {
+		uint64_t s = Prng::derive(seed, i);
+		runs.at(i) = pool.submit([&ctx, &sol, threshold, s, shared, saving,
+			stream]() {
+			return sa(ctx, sol, threshold, s, shared, saving, stream);
+		});
+	}
+
+	/* Wait for each restart to finish */
+	vector<Solution> results(restarts);
+	for (unsigned int i = 0; i < restarts; i++)
+		results.at(i) = pool.get(runs.at(i));
+
+	/* Select best solution among restarts */
+	Solution best = results.at(0);
+	for (unsigned int i = 0; i < results.size(); i++)
+		if (results.at(i).eval(threshold) < best.eval(threshold))
+			best = results.at(i);
+	return best;
+}
+
+/* Run every restart of the configured mode on a pool, keep the best */
+Solution Solver::solve(Context const &ctx, Solution const &sol,
+	double threshold, uint64_t seed, Pool &pool)
+{
+	struct rcvrp_cfg const &cfg = ctx.cfg;
+
+	/* Workers offer their best solutions to be saved, if asked to */
+	Checkpoint checkpoint(cfg.checkpoint ? cfg.checkpoint : "", threshold);
+	Checkpoint *saving = cfg.checkpoint ? &checkpoint : nullptr;
+
+	/* And report new bests as they are found, if asked to */
+	Anytime anytime(cfg.anytime ? cfg.anytime : "-");
+	Anytime *stream = cfg.anytime ? &anytime : nullptr;
+
+	/* Every mode spreads its work over the pool */
+	Solution best = cfg.mode == MODE_TEMPERING ?
+		tempering(ctx, sol, threshold, seed, pool, saving, stream) :
+		cfg.mode == MODE_DECOMPOSE ?
+		decompose(ctx, sol, threshold, seed, pool, saving, stream) :
+		restarts(ctx, sol, threshold, seed, pool, saving, stream);
+
+	/* The final best is saved too */
+	if (saving)
+		saving->offer(best, best.eval(threshold), 0.0, 1.0);
+	return best;
+}
+
+/* Nodes of every route of a solution, in order */
+vector< vector<unsigned int> > Solver::routes(Solution const &sol)
+{
+	Routes lanes(sol, sol.ctx->cfg.risk_threshold);
+	vector< vector<unsigned int> > nodes;
+	for (unsigned int r = 0; r < lanes.ids(); r++) {
+		if (!lanes.used(r))
+			continue;
+		nodes.push_back(vector<unsigned int>(lanes.length(r)));
+		for (unsigned int i = 0; i < lanes.length(r); i++)
+			nodes.back()[i] = lanes.stop(r, i).node;
+	}
+	return nodes;
+}
+
+/* Load some nodes of a context into another one, and routes of theirs */
+Solution Solver::extract(Context const &ctx, vector<unsigned int> const &nodes,
+	vector< vector<unsigned int> > const &routes, Context &part)
+{
+	unsigned int k = (unsigned int)nodes.size();
+	part.cfg.risk_threshold = ctx.cfg.risk_threshold;
+	part.cfg.v_cap = ctx.cfg.v_cap;
+	part.coords.resize(k);
+	part.demand.resize(k);
+	for (unsigned int i = 0; i < k; i++) {
+		part.coords[i] = ctx.coords[nodes[i]];
+		part.demand[i] = ctx.demand[nodes[i]];
+	}
+	part.distance.build(part.coords, (size_t)part.cfg.dist_mem << 20);
+
+	/* Punished just like the whole instance */
+	part.avg_dist = ctx.avg_dist;
+	part.near_k = k > 1 ? min(part.cfg.neighbors, k - 1) : 0;
+	part.near = part.near_k ? Heuristic::neighbors(part.coords,
+		part.near_k) : vector<unsigned int>{};
+
+	/* Routes renumbered, any node of theirs out of the part is dropped */
+	vector<unsigned int> id(ctx.coords.size(), NONE);
+	for (unsigned int i = 0; i < k; i++)
+		id[nodes[i]] = i;
+	Start start{vector< vector<unsigned int> >(routes.size()), 0.0, 0.0};
+	for (unsigned int r = 0; r < routes.size(); r++)
+		for (unsigned int i = 0; i < routes[r].size(); i++)
+			start.routes[r].push_back(id[routes[r][i]]);
+
+	Solution sol(part, k);
+	sol.perm.assign(k, 0);
+	warm(sol, start, part.cfg.risk_threshold);
+	return sol;
+}
+
+/* Change the instance of a context and repair its solution */
+vector<unsigned int> Solver::change(Context &ctx, Solution &sol,
+	vector<Change> const &delta)
+{
+	unsigned int n = (unsigned int)ctx.coords.size();
+
+	/* Every change is checked before any is made */
+	vector<bool> gone(n, false);
+	vector<bool> moved(n, false);
+	vector<Node> added;
+	vector<unsigned int> added_demand;
+	for (unsigned int c = 0; c < delta.size(); c++) {
+		Change const &ch = delta[c];
+		if (ch.kind == Change::INSERT) {
+			added.push_back(ch.at);
+			added_demand.push_back(ch.demand);
+		} else if (!ch.node || ch.node > n) {
+			throw invalid_argument("unknown node " + to_string(ch.node));
+		} else if (ch.kind == Change::REMOVE) {
+			gone[ch.node - 1] = true;
+		} else {
+			moved[ch.node - 1] = true;
+		}
+	}
+	unsigned int k = 0;
+	vector<unsigned int> id(n, NONE);
+	for (unsigned int i = 0; i < n; i++)
+		if (!gone[i])
+			id[i] = k++;
+	unsigned int total = k + (unsigned int)added.size();
+	if (!total)
+		throw invalid_argument("no nodes left");
+
+	/*
+	 * Routes renumbered, without nodes to be inserted again. Nodes next to
+	 * removed ones are touched, as their routes changed.
+	 */
+	vector< vector<unsigned int> > old = routes(sol);
+	Start start{vector< vector<unsigned int> >{}, 0.0, 0.0};
+	vector<unsigned int> touched;
+	for (unsigned int r = 0; r < old.size(); r++) {
+		vector<unsigned int> const &route = old[r];
+		vector<unsigned int> kept;
+		for (unsigned int i = 0; i < route.size(); i++) {
+			unsigned int node = route[i];
+			if (gone[node]) {
+				if (i > 0 && !gone[route[i - 1]])
+					touched.push_back(id[route[i - 1]]);
+				if (i + 1 < route.size() && !gone[route[i + 1]])
+					touched.push_back(id[route[i + 1]]);
+			} else if (moved[node]) {
+				touched.push_back(id[node]);
+			} else {
+				kept.push_back(id[node]);
+			}
+		}
+		if (!kept.empty())
+			start.routes.push_back(kept);
+	}
+	for (unsigned int i = k; i < total; i++)
+		touched.push_back(i);
+
+	/* New demands, and pairs of removed nodes out of the average distance */
+	for (unsigned int c = 0; c < delta.size(); c++)
+		if (delta[c].kind == Change::UPDATE)
+			ctx.demand[delta[c].node - 1] = delta[c].demand;
+	double pairs = n + (double)n * (n - 1) / 2;
+	double sum = ctx.avg_dist * pairs;
+	for (unsigned int i = 0; i < n; i++) {
+		if (!gone[i])
+			continue;
+		sum -= ctx.distance.depot(i);
+		for (unsigned int j = 0; j < n; j++)
+			if (j != i && (!gone[j] || j > i))
+				sum -= ctx.distance(i, j);
+	}
+
+	/* Nodes kept in order, inserted ones after them */
+	for (unsigned int i = 0; i < n; i++) {
+		if (id[i] == NONE)
+			continue;
+		ctx.coords[id[i]] = ctx.coords[i];
+		ctx.demand[id[i]] = ctx.demand[i];
+	}
+	ctx.coords.resize(k);
+	ctx.demand.resize(k);
+	ctx.coords.insert(ctx.coords.end(), added.begin(), added.end());
+	ctx.demand.insert(ctx.demand.end(), added_demand.begin(),
+		added_demand.end());
+
+	/* Only a different set of places needs distances again */
+	if (total != n || k != n) {
+		ctx.distance.build(ctx.coords, (size_t)ctx.cfg.dist_mem << 20);
+		for (unsigned int i = k; i < total; i++) {
+			sum += ctx.distance.depot(i);
+			for (unsigned int j = 0; j < i; j++)
+				sum += ctx.distance(i, j);
+		}
+		pairs = total + (double)total * (total - 1) / 2;
+		ctx.avg_dist = sum / pairs;
+
+		ctx.near_k = total > 1 ? min(ctx.cfg.neighbors, total - 1) : 0;
+		ctx.near = ctx.near_k ? Heuristic::neighbors(ctx.coords,
+			ctx.near_k) : vector<unsigned int>{};
+	}
+
+	/* Nodes left out go where they cost least */
+	Solution repaired(ctx, total);
+	repaired.perm.assign(total, 0);
+	warm(repaired, start, ctx.cfg.risk_threshold);
+	sol = repaired;
+	return touched;
+}
+
+/* Solve again only routes of touched nodes and those around them */
+Solution Solver::replan(Context const &ctx, Solution const &sol,
+	vector<unsigned int> const &touched, double threshold, uint64_t seed,
+	Pool &pool)
+{
+	vector< vector<unsigned int> > all = routes(sol);
+	vector<unsigned int> of(sol.perm.size(), 0);
+	for (unsigned int r = 0; r < all.size(); r++)
+		for (unsigned int i = 0; i < all[r].size(); i++)
+			of[all[r][i]] = r;
+
+	/* Routes of touched nodes and of their candidates */
+	vector<bool> hit(all.size(), false);
+	for (unsigned int t = 0; t < touched.size(); t++) {
+		hit[of[touched[t]]] = true;
+		for (unsigned int c = 0; c < ctx.near_k; c++)
+			hit[of[ctx.near[(size_t)touched[t] * ctx.near_k + c]]] = true;
+	}
+	vector<unsigned int> nodes;
+	vector< vector<unsigned int> > part;
+	Start start{vector< vector<unsigned int> >{}, 0.0, 0.0};
+	for (unsigned int r = 0; r < all.size(); r++) {
+		if (!hit[r]) {
+			start.routes.push_back(all[r]);
+			continue;
+		}
+		part.push_back(all[r]);
+		nodes.insert(nodes.end(), all[r].begin(), all[r].end());
+	}
+	if (nodes.empty())
+		return sol;
+
+	/* Time and budget shrink with the share of nodes solved again */
+	double share = (double)nodes.size() / (double)sol.perm.size();
+	Context focus(ctx.cfg);
+	focus.parent = &ctx;
+	focus.cfg.max_ms = max((unsigned int)ceil(ctx.cfg.max_ms * share), 1u);
+	if (ctx.cfg.budget)
+		focus.cfg.budget = max((unsigned long)ceil((double)ctx.cfg.budget *
+			share),
+			1ul);
+	focus.cfg.checkpoint = nullptr;
+	focus.cfg.anytime = nullptr;
+	focus.cfg.telemetry = nullptr;
+
+	Solution best = solve(focus, extract(ctx, nodes, part, focus),
+		threshold, seed, pool);
+
+	/* Solved routes replace the old ones */
+	part = routes(best);
+	for (unsigned int r = 0; r < part.size(); r++) {
+		for (unsigned int i = 0; i < part[r].size(); i++)
+			part[r][i] = nodes[part[r][i]];
+		start.routes.push_back(part[r]);
+	}
+	Solution out(sol);
+	warm(out, start, threshold);
+	return out;
+}
+
+/* The user given seed, or a random one */
+uint64_t Solver::seed(struct rcvrp_cfg const &cfg)
+{
+	if (cfg.seed)
+		return cfg.seed;
+	return ((uint64_t)random_device{}() << 32) | random_device{}();
+}
@@ -0,0 +1,164 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "telemetry.h"
+#include "config.h"
+#include "context.h"
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using hrc = std::chrono::high_resolution_clock;
+using std::cerr;
+using std::fixed;
+using std::chrono::duration;
+using std::isfinite;
+using std::lock_guard;
+using std::milli;
+using std::mutex;
+using std::ofstream;
+using std::ostream;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+/* Trace samples kept by each worker, only the latest ones survive */
+static unsigned int const TRACE_SIZE = 1024;
+
+/* Names of movements, as indexed by their counter */
+static char const *const KINDS[Move::KINDS + 1] = {
+	"flip", "rotate", "kopt", "relocate", "exchange", "twoopt", "oropt"
+};
+
+/* Costs may be infinite, which JSON can not represent */
+static void number(ostream &out, double x)
+{
+	if (isfinite(x))
+		out << x;
+	else
+		out << "null";
+}
+
+Telemetry::Telemetry(string const &_role, unsigned int capacity)
+	: trace(capacity)
+	, samples(0)
+	, start(hrc::now())
+	, ms(0.0)
+	, best(0.0)
+	, role(_role)
+	, seed(0)
+	, iterations(0)
+	, accepted(0)
+	, improving(0)
+	, infeasible(0)
+	, tried()
+	, taken()
+{}
+
+/* The worker is done, with its best cost */
+void Telemetry::finish(double best_cost)
+{
+	ms = duration<double, milli>(hrc::now() - start).count();
+	best = best_cost;
+}
+
+/* Summary of this worker as a JSON object */
+void Telemetry::json(ostream &out) const
+{
+	out << "{\"role\":\"" << role << "\",\"seed\":" << seed
+		<< ",\"ms\":" << ms << ",\"best\":";
+	number(out, best);
+	out << ",\"iterations\":" << iterations
+		<< ",\"accepted\":" << accepted
+		<< ",\"improving\":" << improving
+		<< ",\"infeasible\":" << infeasible
+		<< ",\"iterations_per_s\":"
+		<< (ms > 0.0 ? (double)iterations * 1000.0 / ms : 0.0)
+		<< ",\"operators\":{";
+	for (unsigned int k = 0; k <= Move::KINDS; k++)
+		out << (k ? "," : "") << '"' << KINDS[k] << "\":{\"tried\":"
+			<< tried[k] << ",\"accepted\":" << taken[k] << '}';
+
+	/* Oldest sample first */
+	out << "},\"trace\":[";
+	unsigned long n = samples < trace.size() ? samples : trace.size();
+	for (unsigned long i = samples - n; i < samples; i++) {
+		Sample const &s = trace[i % trace.size()];
+		out << (i + n > samples ? "," : "") << '[' << s.it << ',';
+		number(out, s.temp);
+		out << ',';
+		number(out, s.cost);
+		out << ']';
+	}
+	out << "]}";
+}
+
+/* New record for a worker of a context, or null if telemetry is disabled */
+Telemetry *Telemetry::enroll(Context const &ctx, string const &role)
+{
+	if (!ctx.cfg.telemetry)
+		return nullptr;
+
+	lock_guard<mutex> lock(ctx.enrolled_lock);
+	ctx.enrolled.push_back(unique_ptr<Telemetry>(
+		new Telemetry(role, TRACE_SIZE)));
+	return ctx.enrolled.back().get();
+}
+
+/* Write the summary of every worker of a context so far, if enabled */
+void Telemetry::report(Context const &ctx)
+{
+	if (!ctx.cfg.telemetry)
+		return;
+
+	lock_guard<mutex> lock(ctx.enrolled_lock);
+	vector< unique_ptr<Telemetry> > const &enrolled = ctx.enrolled;
+	ofstream file;
+	string path = ctx.cfg.telemetry;
+	if (path != "-")
+		file.open(path);
+	ostream &out = path == "-" ? cerr : file;
+
+	/* Totals over every worker, then each one of them */
+	unsigned long iterations = 0, accepted = 0, improving = 0;
+	unsigned long infeasible = 0;
+	for (unsigned int i = 0; i < enrolled.size(); i++) {
+		iterations += enrolled[i]->iterations;
+		accepted += enrolled[i]->accepted;
+		improving += enrolled[i]->improving;
+		infeasible += enrolled[i]->infeasible;
+	}
+	out.precision(6);
+	out << fixed << "{\"threads\":" << ctx.cfg.threads
+		<< ",\"workers\":" << enrolled.size()
+		<< ",\"iterations\":" << iterations
+		<< ",\"accepted\":" << accepted
+		<< ",\"improving\":" << improving
+		<< ",\"infeasible\":" << infeasible
+		<< ",\"runs\":[";
+	for (unsigned int i = 0; i < enrolled.size(); i++) {
+		out << (i ? "," : "");
+		enrolled[i]->json(out);
+	}
+	out << "]}\n";
+}
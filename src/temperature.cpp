@@ -18,14 +18,203 @@
 
 #include "temperature.h"
 #include "config.h"
+#include "prng.h"
+#include "solution.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using dl = std::numeric_limits<double>;
+using std::exp;
+using std::fabs;
+using std::isfinite;
+using std::max;
+using std::max_element;
+using std::min;
+using std::min_element;
+using std::nth_element;
+using std::pow;
+using std::sqrt;
+using std::vector;
+
+/* Random moves sampled to calibrate a schedule */
+static unsigned int const CALIBRATION_SAMPLES = 512;
+
+/*
+ * Share of moves accepted at the start and end of a run, and how much the
+ * temperature may change on each update to get there. It never goes over
+ * the one calibrated to start with, nor far below.
+ */
+static double const START_ACCEPTANCE = 0.3;
+static double const END_ACCEPTANCE = 0.001;
+static double const STEER = 2.0;
+static double const FLOOR = 1e-6;
+
+/*
+ * A chain is frozen after this many updates accepting fewer moves than this
+ * share, without improving. It is reheated this much then, unless the run is
+ * nearly over.
+ */
+static unsigned int const FROZEN_UPDATES = 8;
+static double const FROZEN_ACCEPTANCE = 0.002;
+static double const REHEAT = 8.0;
+static double const REHEAT_UNTIL = 0.9;
+
+/* Cost increases negligible next to the cost itself */
+static double const NEGLIGIBLE = 1e-9;
+
+/* Geometric cooling from a given temperature */
+Temperature::Temperature(double _curr, struct rcvrp_cfg const &cfg)
+	: curr(_curr)
+	, it(0)
+	, every(cfg.max_iter)
+	, multiplier(cfg.temp_multiplier)
+	, calibrated(false)
+	, top(_curr)
+	, seen_it(0)
+	, seen_accepted(0)
+	, seen_best(dl::infinity())
+	, frozen(0)
+{}
+
+/*
+ * Schedule calibrated from moves of a solution. Good solutions are reached
+ * by making most moves worse, so their sizes tell how much worse moves will
+ * be.
+ */
+Temperature::Temperature(Solution &sol, Prng &rng,
+	struct rcvrp_cfg const &cfg)
+	: Temperature(cfg.temperature, cfg)
+{
+	vector<double> diffs = deltas(sol, rng, CALIBRATION_SAMPLES);
+	if (!diffs.empty())
+		top = calibrate(diffs, START_ACCEPTANCE);
+	calibrated = true;
+	curr = top;
+
+	/* A resumed run goes on as cold as it was */
+	if (cfg.resume_temperature > 0.0)
+		curr = min(top, cfg.resume_temperature);
+}
 
 double Temperature::operator() (void)
 {
+	/* Calibrated schedules only change on updates */
+	if (calibrated)
+		return curr;
+
 	/* Update temperature every fixed amount of iterations. */
 	double r = this->curr;
-	if (this->curr > 1 && this->it++ % ctx.max_iter == 0) {
-		this->curr *= ctx.temp_multiplier;
+	if (this->curr > 1 && this->it++ % every == 0) {
+		this->curr *= multiplier;
 		this->it = 0;
 	}
 	return r;
 }
+
+/*
+ * Follow the calibrated schedule at some progress of the run, from 0 to 1,
+ * given the iterations, accepted moves and best cost so far. The share of
+ * moves to accept shrinks geometrically to be cold when the run is over, and
+ * the temperature is steered to accept that many. While improving moves
+ * abound, they are enough and the temperature drops.
+ */
+void Temperature::adapt(double progress, unsigned long iterations,
+	unsigned long accepted, double best)
+{
+	if (!calibrated)
+		return;
+
+	progress = min(max(progress, 0.0), 1.0);
+	double target = START_ACCEPTANCE
+		* pow(END_ACCEPTANCE / START_ACCEPTANCE, progress);
+
+	/* Share of moves accepted since the last update */
+	unsigned long tried = iterations - seen_it;
+	double rate = tried ? (double)(accepted - seen_accepted) / (double)tried
+		: target;
+	double ratio = min(max(target / max(rate, target / STEER),
+		1.0 / STEER), STEER);
+	curr = min(max(curr * ratio, top * FLOOR), top);
+
+	/* Count updates hardly accepting anything, nor improving */
+	if (best < seen_best || !(rate < FROZEN_ACCEPTANCE))
+		frozen = 0;
+	else
+		frozen++;
+	seen_it = iterations;
+	seen_accepted = accepted;
+	seen_best = min(seen_best, best);
+
+	/* Reheat a frozen chain, it is cooled again by the end */
+	if (frozen >= FROZEN_UPDATES && progress < REHEAT_UNTIL) {
+		curr = min(top, curr * REHEAT);
+		frozen = 0;
+	}
+}
+
+/*
+ * Sizes of the cost changes of random moves from a solution, better or worse.
+ * Moves changing the cost by rounding errors only are left out. No move is
+ * applied, but drawing one may rotate the solution into an equivalent order
+ * of the same routes and cost.
+ */
+vector<double> Temperature::deltas(Solution &sol, Prng &rng,
+	unsigned int samples)
+{
+	vector<double> diffs;
+	diffs.reserve(samples);
+	double least = fabs(sol.cost()) * NEGLIGIBLE;
+	for (unsigned int i = 0; i < samples; i++) {
+		double diff = fabs(sol.delta(sol.any_neighbor(rng)));
+		if (diff > least && isfinite(diff))
+			diffs.push_back(diff);
+	}
+	return diffs;
+}
+
+/*
+ * Median cost increase of worsening random moves from a solution. Moves into
+ * routes over the risk threshold are punished heavily, so the mean would be
+ * dominated by a few of them.
+ */
+double Temperature::sample(Solution &sol, Prng &rng, unsigned int samples)
+{
+	vector<double> worse;
+	worse.reserve(samples);
+
+	/* Only evaluate moves, the solution keeps its routes and cost */
+	for (unsigned int i = 0; i < samples; i++) {
+		double diff = sol.delta(sol.any_neighbor(rng));
+		if (diff > 0.0 && isfinite(diff))
+			worse.push_back(diff);
+	}
+	if (worse.empty())
+		return 0.0;
+	nth_element(worse.begin(), worse.begin() + worse.size() / 2,
+		worse.end());
+	return worse[worse.size() / 2];
+}
+
+/*
+ * Temperature at which worsening moves of these costs would be accepted with
+ * some probability on average, found by bisection. Average acceptance grows with
+ * temperature, from none to every move.
+ */
+double Temperature::calibrate(vector<double> const &worse, double acceptance)
+{
+	double lo = *min_element(worse.begin(), worse.end()) * 1e-3;
+	double hi = *max_element(worse.begin(), worse.end()) * 1e3;
+	for (unsigned int i = 0; i < 64; i++) {
+		double mid = sqrt(lo * hi);
+		double sum = 0.0;
+		for (unsigned int j = 0; j < worse.size(); j++)
+			sum += exp(-worse[j] / mid);
+		if (sum / (double)worse.size() < acceptance)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return sqrt(lo * hi);
+}
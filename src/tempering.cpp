@@ -0,0 +1,192 @@
+/*
+ * RCVRP
+ * A Simulated Annealing solver for the Risk-constrained Cash-in-transit VRP
+ * Copyright (C) 2017  Manuel Weitzman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "tempering.h"
+#include "anytime.h"
+#include "chain.h"
+#include "checkpoint.h"
+#include "config.h"
+#include "context.h"
+#include "pool.h"
+#include "prng.h"
+#include "solution.h"
+#include "telemetry.h"
+#include "temperature.h"
+#include "timer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <vector>
+
+using std::future;
+using std::log;
+using std::max;
+using std::min;
+using std::pow;
+using std::swap;
+using std::uint64_t;
+using std::vector;
+
+/* Acceptance ratio of a typical worsening move at both ladder ends */
+static double const HOT_ACCEPTANCE = 0.8;
+static double const COLD_ACCEPTANCE = 0.001;
+
+/* Amount of moves sampled to space the ladder */
+static unsigned int const LADDER_SAMPLES = 1024;
+
+/* Geometric ladder of n temperatures, spaced from sampled move deltas */
+static vector<double> ladder(Solution &sol, Prng &rng, unsigned int n)
+{
+	/* Temperatures at which a typical worsening is accepted as wanted */
+	double typical = Temperature::sample(sol, rng, LADDER_SAMPLES);
+	double hot = sol.ctx->cfg.temperature;
+	double cold = 1.0;
+	if (typical > 0.0) {
+		hot = -typical / log(HOT_ACCEPTANCE);
+		cold = -typical / log(COLD_ACCEPTANCE);
+	}
+
+	/* Coldest first */
+	vector<double> temp(n);
+	for (unsigned int i = 0; i < n; i++)
+		temp[i] = cold * pow(hot / cold, n > 1 ? (double)i / (n - 1) : 0.0);
+	return temp;
+}
+
+Solution tempering(Context const &ctx, Solution sol, double risk,
+	uint64_t seed, Pool &pool, Checkpoint *saving, Anytime *stream)
+{
+	struct rcvrp_cfg const &cfg = ctx.cfg;
+
+	/* Start from the shared greedy solution */
+	sol.track(risk);
+
+	/* Some replicas per group, at least a couple of them */
+	unsigned int groups = max(cfg.threads, 1u);
+	unsigned int n = cfg.replicas ? cfg.replicas : max(2 * groups, 4u);
+	n = max(n, 2u);
+	groups = min(groups, n);
+
+	/* Every replica starts from the same solution, each with its own PRNG */
+	Prng rng(seed);
+	vector<double> temp = ladder(sol, rng, n);
+	vector<Chain> chains;
+	vector<unsigned int> at(n);
+	chains.reserve(n);
+	for (unsigned int i = 0; i < n; i++) {
+		chains.push_back(Chain(sol, Prng::derive(seed, i + 1)));
+		at[i] = i;
+	}
+
+	/* Records and trace state of each group */
+	vector<Telemetry *> tms(groups);
+	vector<unsigned long> its(groups, 0);
+	vector<unsigned long> nexts(groups, 0);
+	for (unsigned int g = 0; g < groups; g++) {
+		tms[g] = Telemetry::enroll(ctx, "tempering");
+		if (tms[g])
+			tms[g]->seed = seed;
+	}
+
+	/*
+	 * A group runs a fixed subset of temperatures between exchanges, cut
+	 * short once told to stop or out of time, with a clock of its own
+	 */
+	vector<Timer> clocks(groups);
+	auto segment = [&](unsigned int id) {
+		Telemetry *tm = tms[id];
+		bool late = false;
+		for (unsigned int l = id; l < n && !late; l += groups) {
+			Chain &c = chains[at[l]];
+			Fixed t(temp[l]);
+			c.tm = tm;
+			unsigned int i = 0;
+			while (i < cfg.migration && !late) {
+				i += c.steps(t, cfg.candidates);
+				late = ctx.stopped() || (!cfg.budget &&
+					!clocks[id].running(cfg.max_ms));
+			}
+			its[id] += i;
+			if (stream && c.best_cost < stream->cost())
+				stream->offer(c.best_cost, c.best_fleet());
+
+			/* Trace the coldest replica of this group */
+			if (tm && l == id && its[id] >= nexts[id]) {
+				tm->sample(its[id], temp[l], c.curr.cost());
+				nexts[id] = its[id] + cfg.trace_every;
+			}
+		}
+	};
+
+	bool done = false;
+	unsigned long round = 0;
+	double offered = 0.0;
+	Timer timer;
+	vector< future<void> > runs(groups);
+	while (!done) {
+		/* Groups run as tasks of the pool, all of them between exchanges */
+		for (unsigned int g = 0; g < groups; g++)
+			runs[g] = pool.submit([&segment, g]() { segment(g); });
+		for (unsigned int g = 0; g < groups; g++)
+			pool.get(runs[g]);
+
+		/* Swap replicas of adjacent temperatures, odd and even pairs in turns */
+		for (unsigned int l = round++ % 2; l + 1 < n; l += 2) {
+			double ea = chains[at[l]].curr.cost();
+			double eb = chains[at[l + 1]].curr.cost();
+			double x = (1.0 / temp[l] - 1.0 / temp[l + 1]) * (ea - eb);
+			if (rng.metropolis(x, 1.0))
+				swap(at[l], at[l + 1]);
+		}
+		done = ctx.stopped() || (cfg.budget ?
+			round * cfg.migration >= cfg.budget :
+			!timer.loop_incomplete(cfg.max_ms));
+
+		/* Maybe offer the best replica to be saved */
+		double ms = timer.elapsed();
+		if (saving && ms >= offered + cfg.checkpoint_ms) {
+			unsigned int b = 0;
+			for (unsigned int i = 1; i < n; i++)
+				if (chains[i].best_cost < chains[b].best_cost)
+					b = i;
+			saving->offer(chains[b].snapshot(), chains[b].best_cost,
+				temp[0], cfg.budget ?
+				(double)(round * cfg.migration) / (double)cfg.budget :
+				ms / cfg.max_ms);
+			offered = ms;
+		}
+	}
+
+	/* Best cost among replicas each group ran last */
+	for (unsigned int g = 0; g < groups; g++) {
+		if (!tms[g])
+			continue;
+		double best = chains[at[g]].best_cost;
+		for (unsigned int l = g; l < n; l += groups)
+			best = min(best, chains[at[l]].best_cost);
+		tms[g]->finish(best);
+	}
+
+	/* Best solution among every replica */
+	unsigned int best = 0;
+	for (unsigned int i = 1; i < n; i++)
+		if (chains[i].best_cost < chains[best].best_cost)
+			best = i;
+	return chains[best].snapshot();
+}
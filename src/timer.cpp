@@ -17,14 +17,24 @@
  */
 
 #include "timer.h"
+#include <algorithm>
+#include <chrono>
 
 using hrc = std::chrono::high_resolution_clock;
 using ms = std::chrono::milliseconds;
 using std::chrono::duration_cast;
+using std::max;
+using std::min;
+
+/* Most a loop checking the clock only every few calls may run late */
+static double const OVERSHOOT_MS = 1.0;
 
 /* Create timer, set start time as creation time */
 Timer::Timer(void)
 	: start{hrc::now()}
+	, last{start}
+	, every(1)
+	, left(1)
 {}
 
 /* Get time elapsed since timer creation in milliseconds */
@@ -32,3 +42,31 @@ bool Timer::loop_incomplete(unsigned int looptime)
 {
 	return duration_cast<ms>(hrc::now() - start) < ms(looptime);
 }
+
+/* Milliseconds elapsed since timer creation */
+double Timer::elapsed(void) const
+{
+	return std::chrono::duration<double, std::milli>(hrc::now() - start)
+		.count();
+}
+
+/*
+ * Whether looptime has not passed yet, reading the clock only every few calls.
+ * How many is adapted to the time calls take, so looptime is overshot by
+ * OVERSHOOT_MS at most. It grows slowly, in case calls get slower.
+ */
+bool Timer::running(unsigned int looptime)
+{
+	if (--left > 0)
+		return true;
+
+	hrc::time_point now = hrc::now();
+	double per_call = std::chrono::duration<double, std::milli>(now - last)
+		.count() / (double)every;
+	last = now;
+	unsigned long fit = per_call > 0.0 ?
+		(unsigned long)(OVERSHOOT_MS / per_call) : 2 * every;
+	every = min(max(fit, 1ul), 2 * every);
+	left = every;
+	return duration_cast<ms>(now - start) < ms(looptime);
+}